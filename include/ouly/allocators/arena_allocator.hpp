@@ -4,9 +4,12 @@
 #include "ouly/allocators/detail/arena.hpp"
 #include "ouly/allocators/detail/arena_manager_defs.hpp"
 
+#include <algorithm>
 #include <bit>
 #include <concepts>
 #include <functional>
+#include <map>
+#include <span>
 #include <tuple>
 
 /**
@@ -59,7 +62,7 @@ concept MemoryManager = requires(T m) {
    */
   { m.drop_arena(std::uint32_t()) } -> std::same_as<bool>;
   /**
-   * Add an arena
+   * Add an arena, returns std::numeric_limits<std::uint32_t>::max() if the memory cannot be provided
    */
   { m.add_arena(std::uint32_t(), std::size_t()) } -> std::same_as<std::uint32_t>;
   // Remoe an arena
@@ -133,6 +136,8 @@ public:
 
   static constexpr bool has_memory_mgr = ouly::detail::HasMemoryManager<Config>;
   static constexpr bool can_defragment = HasDefragmentSupport<arena_manager, this_type>;
+  // Moves larger than this are split when handed to a defragment move executor
+  static constexpr std::size_t move_chunk_size = std::size_t{1} << 20U;
 
 protected:
   using config = Config;
@@ -351,6 +356,10 @@ public:
       auto ret = add_arena(huser, size, false);
       if constexpr (has_memory_mgr)
       {
+        if (ret.first == 0)
+        {
+          return alloc_info();
+        }
         return alloc_info(ibank_.bank_.arenas()[ret.first].data_, ret.second, 0);
       }
       else
@@ -473,6 +482,10 @@ public:
         }
 
         std::uint32_t arena_id = blk.arena_;
+        if (defrag_arena_ == arena_id)
+        {
+          defrag_arena_ = 0;
+        }
         ibank_.bank_.free_size_ -= arena.size();
         arena.size_ = 0;
         arena.block_order().clear(ibank_.bank_.blocks());
@@ -596,6 +609,182 @@ public:
    */
   void defragment()
     requires(can_defragment)
+  {
+    sequential_moves executor;
+    defragment_impl(executor);
+  }
+
+  /**
+   * @brief Defragments like defragment(), handing the memory moves to a move executor.
+   *
+   * The moves are split in batches, in order. The moves of a batch never write memory another move of the same batch
+   * reads or writes, so the executor may run them concurrently, but a batch must be complete before the next one is
+   * passed. Moves larger than move_chunk_size that do not overlap themselves are split in chunks of that size. The
+   * executor is called as:
+   * ```cpp
+   *   executor(std::span<memory_move const> batch, auto const& move);
+   * ```
+   * where `move(memory_move const&)` forwards one move to the manager's move_memory, which must then be safe to call
+   * concurrently for disjoint ranges.
+   *
+   * @see parallel_move_executor to run the batches with parallel_for
+   */
+  template <typename Executor>
+  void defragment(Executor&& executor)
+    requires(can_defragment)
+  {
+    defragment_impl(executor);
+  }
+
+  /**
+   * @brief Incrementally compacts the arenas, moving about max_bytes_to_move bytes per call.
+   *
+   * Every call resumes with the arena the previous call stopped at and slides its allocated blocks over the free blocks
+   * before them, until the free space of the arena is a single block at its end. Blocks stay in their arena and keep
+   * their ids, only their offsets change, so the allocator can be used normally between two steps. The moves of a step
+   * are coalesced with push_memmove and issued between begin_defragment and end_defragment, followed by a rebind_alloc
+   * for every moved block. A block larger than the budget is still moved if it is the first one of the call.
+   *
+   * Unlike defragment(), blocks are never moved to another arena and no arena is removed.
+   *
+   * @param max_bytes_to_move Budget of bytes to move in this call
+   * @return true if the pass over all arenas is complete, false if more steps are needed
+   * @note Statistics report the fragmented_size() left after the step if Config includes ComputeStats
+   */
+  auto defragment_step(size_type max_bytes_to_move) -> bool
+    requires(can_defragment)
+  {
+    sequential_moves executor;
+    return defragment_step_impl(max_bytes_to_move, executor);
+  }
+
+  /**
+   * @brief Runs a defragment_step, handing the memory moves to a move executor as described for defragment(Executor)
+   */
+  template <typename Executor>
+  auto defragment_step(size_type max_bytes_to_move, Executor&& executor) -> bool
+    requires(can_defragment)
+  {
+    return defragment_step_impl(max_bytes_to_move, executor);
+  }
+
+  /**
+   * @brief Total size of the free blocks that have an allocated block after them in their arena
+   *
+   * This is the free space a compaction would gather at the end of the arenas, a fully compacted allocator returns 0.
+   */
+  [[nodiscard]] auto fragmented_size() const -> size_type
+  {
+    size_type total = 0;
+    for (auto arena_it     = ibank_.bank_.arena_order_.begin(ibank_.bank_.arenas()),
+              arena_end_it = ibank_.bank_.arena_order_.end(ibank_.bank_.arenas());
+         arena_it != arena_end_it; ++arena_it)
+    {
+      for (auto blk_it     = arena_it->block_order().begin(ibank_.bank_.blocks()),
+                blk_end_it = arena_it->block_order().end(ibank_.bank_.blocks());
+           blk_it != blk_end_it; ++blk_it)
+      {
+        if (blk_it->is_free_ && blk_it->arena_order_.next_ != 0)
+        {
+          total += blk_it->size();
+        }
+      }
+    }
+    return total;
+  }
+
+  /**
+   * @brief Returns the telemetry of the allocator
+   *
+   * The size and latency histograms are filled if Config includes cfg::compute_histograms. The free block count and
+   * the largest free block of every arena are always collected, by walking the blocks of the arenas.
+   */
+  [[nodiscard]] auto telemetry() const -> memory_telemetry
+  {
+    memory_telemetry out;
+    this->statistics::export_telemetry(out);
+    for (auto arena_it = ibank_.bank_.arena_order_.front(); arena_it != 0;
+         arena_it      = ibank_.bank_.arena_order_.next(ibank_.bank_.arenas(), arena_it))
+    {
+      auto const&                  arena = ibank_.bank_.arenas()[arena_it];
+      memory_telemetry::arena_info info;
+      info.id_   = arena_it;
+      info.size_ = arena.size();
+      info.free_ = arena.free_;
+      for (auto blk_it     = arena.block_order().begin(ibank_.bank_.blocks()),
+                blk_end_it = arena.block_order().end(ibank_.bank_.blocks());
+           blk_it != blk_end_it; ++blk_it)
+      {
+        if (blk_it->is_free_)
+        {
+          info.free_blocks_++;
+          info.largest_free_ = std::max<std::uint64_t>(info.largest_free_, blk_it->size());
+        }
+      }
+      out.arenas_.push_back(info);
+    }
+    return out;
+  }
+
+private:
+  /**
+   * @brief Executor that runs every move in order on the calling thread
+   */
+  struct sequential_moves
+  {};
+
+  /**
+   * @brief Union of memory ranges touched by a batch of moves, as disjoint [start, end) intervals keyed by arena
+   * handle and start
+   */
+  class move_ranges
+  {
+  public:
+    [[nodiscard]] auto overlaps(std::uint32_t handle, std::size_t offset, std::size_t size) const -> bool
+    {
+      // Only the last interval starting before the end of the range can reach into it
+      auto it = ranges_.lower_bound({handle, offset + size});
+      if (it == ranges_.begin())
+      {
+        return false;
+      }
+      --it;
+      return it->first.first == handle && it->second > offset;
+    }
+
+    void add(std::uint32_t handle, std::size_t offset, std::size_t size)
+    {
+      auto start = offset;
+      auto end   = offset + size;
+      auto it    = ranges_.lower_bound({handle, start});
+      if (it != ranges_.begin())
+      {
+        auto prev = std::prev(it);
+        if (prev->first.first == handle && prev->second > start)
+        {
+          start = prev->first.second;
+          it    = prev;
+        }
+      }
+      while (it != ranges_.end() && it->first.first == handle && it->first.second < end)
+      {
+        end = std::max(end, it->second);
+        it  = ranges_.erase(it);
+      }
+      ranges_.emplace_hint(it, std::pair{handle, start}, end);
+    }
+
+    void clear() noexcept
+    {
+      ranges_.clear();
+    }
+
+  private:
+    std::map<std::pair<std::uint32_t, std::size_t>, std::size_t> ranges_;
+  };
+
+  template <typename Executor>
+  void defragment_impl(Executor& executor)
   {
     mgr_->begin_defragment(*this);
     // refresh all banks
@@ -654,12 +843,8 @@ public:
       }
     }
 
-    for (auto& m : moves)
-    {
-      // follow the copy sequence to ensure there is no overwrite
-      mgr_->move_memory(ibank_.bank_.arenas_[m.arena_src_].data_, refresh.bank_.arenas_[m.arena_dst_].data_, m.from_,
-                        m.to_, m.size_);
-    }
+    // follow the copy sequence to ensure there is no overwrite
+    execute_moves(moves, ibank_.bank_.arenas_, refresh.bank_.arenas_, executor);
 
     for (auto rb : rebinds)
     {
@@ -680,18 +865,70 @@ public:
 
     ibank_.bank_  = std::move(refresh.bank_);
     ibank_.strat_ = std::move(refresh.strat_);
+    defrag_arena_ = 0;
     mgr_->end_defragment(*this);
   }
 
-private:
+  template <typename Executor>
+  auto defragment_step_impl(size_type max_bytes_to_move, Executor& executor) -> bool
+  {
+    if (defrag_arena_ == 0)
+    {
+      defrag_arena_ = ibank_.bank_.arena_order_.front();
+    }
+
+    mgr_->begin_defragment(*this);
+
+    ouly::vector<memory_move>   moves;
+    ouly::vector<std::uint32_t> rebinds;
+    size_type                   moved = 0;
+    while (defrag_arena_ != 0 && compact_arena(defrag_arena_, max_bytes_to_move, moved, moves, rebinds))
+    {
+      defrag_arena_ = ibank_.bank_.arena_order_.next(ibank_.bank_.arenas(), defrag_arena_);
+    }
+
+    // moves only go towards the start of an arena and are in offset order, so none overwrites a pending source
+    execute_moves(moves, ibank_.bank_.arenas_, ibank_.bank_.arenas_, executor);
+
+    for (auto rb : rebinds)
+    {
+      auto& blk = ibank_.bank_.blocks()[block_link(rb)];
+      mgr_->rebind_alloc(blk.data_, ibank_.bank_.arenas()[blk.arena_].data_, rb, blk.adjusted_offset());
+    }
+
+    if constexpr (ouly::detail::HasComputeStats<Config>)
+    {
+      statistics::report_defrag_remaining(fragmented_size());
+    }
+    mgr_->end_defragment(*this);
+    return defrag_arena_ == 0;
+  }
+
+  /**
+   * @brief Adds an arena, returns {0, 0} if the manager could not provide its memory
+   */
   auto add_arena(std::uint32_t handle, size_type iarena_size, bool empty) -> std::pair<std::uint32_t, std::uint32_t>
   {
-    this->statistics::report_new_arena();
     auto ret = add_arena(ibank_, handle, iarena_size, empty);
     if constexpr (has_memory_mgr)
     {
-      ibank_.bank_.arenas()[ret.first].data_ = mgr_->add_arena(ret.first, iarena_size);
+      auto data = mgr_->add_arena(ret.first, iarena_size);
+      if (data == std::numeric_limits<std::uint32_t>::max())
+      {
+        auto& arena = ibank_.bank_.arenas()[ret.first];
+        if (empty)
+        {
+          ibank_.strat_.erase(ibank_.bank_.blocks(), ret.second);
+          ibank_.bank_.free_size_ -= iarena_size;
+        }
+        arena.size_ = 0;
+        arena.block_order().clear(ibank_.bank_.blocks());
+        ibank_.bank_.arena_order_.erase(ibank_.bank_.arenas(), ret.first);
+        return {0, 0};
+      }
+      ibank_.bank_.arenas()[ret.first].data_ = data;
     }
+    this->statistics::report_new_arena();
     return ret;
   }
 
@@ -735,6 +972,58 @@ private:
     return ((blk.offset_ + alignment) & ~alignment);
   }
 
+  /**
+   * @brief Slides the allocated blocks of an arena over the free block before them while the budget allows
+   * @return true if the arena is compacted, false if the budget ran out first
+   */
+  auto compact_arena(std::uint32_t arena_id, size_type budget, size_type& moved, ouly::vector<memory_move>& moves,
+                     ouly::vector<std::uint32_t>& rebinds) -> bool
+  {
+    auto& blocks    = ibank_.bank_.blocks();
+    auto& node_list = ibank_.bank_.arenas()[arena_id].block_order();
+
+    auto hole = node_list.front();
+    while (hole != 0 && !blocks[block_link(hole)].is_free_)
+    {
+      hole = blocks[block_link(hole)].arena_order_.next_;
+    }
+
+    while (hole != 0)
+    {
+      auto& free_blk = blocks[block_link(hole)];
+      auto  next     = free_blk.arena_order_.next_;
+      if (next == 0)
+      {
+        return true;
+      }
+
+      // Free neighbours are always merged, so the next block is allocated
+      auto& blk = blocks[block_link(next)];
+      if (moved != 0 && blk.size_ > budget - std::min(moved, budget))
+      {
+        return false;
+      }
+
+      auto src         = blk.adjusted_block();
+      blk.offset_      = free_blk.offset_;
+      free_blk.offset_ = blk.offset_ + blk.size_;
+      node_list.unlink(blocks, hole);
+      node_list.insert_after(blocks, next, hole);
+      push_memmove(moves, memory_move(src.first, blk.adjusted_offset(), src.second, arena_id, arena_id));
+      rebinds.emplace_back(next);
+      moved += blk.size_;
+
+      auto right = free_blk.arena_order_.next_;
+      if (right != 0 && blocks[block_link(right)].is_free_)
+      {
+        ibank_.strat_.erase(blocks, right);
+        ibank_.strat_.grow_free_node(blocks, hole, free_blk.size_ + blocks[block_link(right)].size_);
+        node_list.erase(blocks, right);
+      }
+    }
+    return true;
+  }
+
   static void copy(block const& src, block& dst)
   {
     dst.data_      = src.data_;
@@ -766,9 +1055,75 @@ private:
     }
   }
 
+  /**
+   * @brief Issues the moves through executor, in batches of moves that do not write memory touched by another move of
+   * the batch
+   *
+   * Overlaps are checked on the manager's arena handles, as the arenas of a refreshed bank reuse the memory of the old
+   * ones.
+   */
+  template <typename Executor>
+  void execute_moves(ouly::vector<memory_move> const& moves, arena_bank const& src, arena_bank const& dst,
+                     Executor& executor)
+  {
+    auto move = [this, &src, &dst](memory_move const& m)
+    {
+      mgr_->move_memory(src[m.arena_src_].data_, dst[m.arena_dst_].data_, m.from_, m.to_, m.size_);
+    };
+
+    if constexpr (std::is_same_v<Executor, sequential_moves>)
+    {
+      for (auto const& m : moves)
+      {
+        move(m);
+      }
+    }
+    else
+    {
+      // Ranges read and written by the current batch, each kept as disjoint intervals ordered by arena and start so a
+      // move is checked against the whole batch in O(log n)
+      move_ranges               reads;
+      move_ranges               writes;
+      ouly::vector<memory_move> batch;
+      for (auto const& m : moves)
+      {
+        auto m_src = src[m.arena_src_].data_;
+        auto m_dst = dst[m.arena_dst_].data_;
+        if (writes.overlaps(m_dst, m.to_, m.size_) || reads.overlaps(m_dst, m.to_, m.size_) ||
+            writes.overlaps(m_src, m.from_, m.size_))
+        {
+          executor(std::span<memory_move const>(batch), move);
+          batch.clear();
+          reads.clear();
+          writes.clear();
+        }
+        reads.add(m_src, m.from_, m.size_);
+        writes.add(m_dst, m.to_, m.size_);
+
+        if (m_src == m_dst && m.from_ < m.to_ + m.size_ && m.to_ < m.from_ + m.size_)
+        {
+          batch.push_back(m);
+          continue;
+        }
+        for (std::size_t offset = 0; offset < m.size_; offset += move_chunk_size)
+        {
+          auto chunk = static_cast<size_type>(std::min<std::size_t>(move_chunk_size, m.size_ - offset));
+          batch.emplace_back(static_cast<size_type>(m.from_ + offset), static_cast<size_type>(m.to_ + offset), chunk,
+                             m.arena_src_, m.arena_dst_);
+        }
+      }
+      if (!batch.empty())
+      {
+        executor(std::span<memory_move const>(batch), move);
+      }
+    }
+  }
+
   remap_data     ibank_;
   size_type      arena_size_ = std::numeric_limits<size_type>::max();
   arena_manager* mgr_        = nullptr;
+  // Arena defragment_step resumes with
+  std::uint32_t defrag_arena_ = 0;
 };
 
 } // namespace ouly
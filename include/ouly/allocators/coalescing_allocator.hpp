@@ -3,6 +3,8 @@
 
 #include "ouly/allocators/config.hpp"
 #include <limits>
+#include <set>
+#include <utility>
 #include <vector>
 
 namespace ouly
@@ -26,8 +28,13 @@ using coalescing_allocator_size_type = std::conditional_t<cfg::coalescing_alloca
  * - Merges adjacent free blocks on deallocation
  * - Tracks memory using offset/size pairs
  * - Manages a sorted list of free blocks
+ * - Best fit allocation in O(log n) through a size ordered index of the free blocks
  * - Suitable for scenarios requiring defragmented memory allocation
  *
+ * Free blocks are kept sorted by offset for coalescing. A block that is used up is left in place with a size of 0 and
+ * reused by a later free block that sorts close to it, so allocation never shifts the arrays. They are compacted once
+ * such empty entries make up half of them, or once a run of them gets long enough to slow down the walks over it.
+ *
  * @note The allocator starts with one maximum-sized free block
  */
 class coalescing_allocator
@@ -38,10 +45,30 @@ public:
   auto allocate(size_type size) -> size_type;
   void deallocate(size_type offset, size_type size);
 
+  /**
+   * @brief Number of free blocks
+   */
+  [[nodiscard]] auto get_free_block_count() const noexcept -> std::size_t
+  {
+    return by_size_.size();
+  }
+
 private:
-  // Free blocks
-  std::vector<size_type> offsets_ = {0};
-  std::vector<size_type> sizes_   = {std::numeric_limits<size_type>::max()};
+  auto find(size_type offset) const noexcept -> std::size_t;
+  auto needs_compact(std::size_t walked) const noexcept -> bool;
+  auto open_slot(std::size_t idx) -> std::size_t;
+  void resize_free(std::size_t idx, size_type offset, size_type size);
+  void revive(std::size_t idx, size_type offset, size_type size);
+  void tombstone(std::size_t idx);
+  void settle(std::size_t idx);
+  void compact();
+
+  // Free blocks, sorted by offset, a size of 0 marks an entry whose block was used up
+  std::vector<size_type>                    offsets_ = {0};
+  std::vector<size_type>                    sizes_   = {std::numeric_limits<size_type>::max()};
+  // Free blocks sorted by size then offset
+  std::set<std::pair<size_type, size_type>> by_size_ = {{std::numeric_limits<size_type>::max(), 0}};
+  std::size_t                               empty_   = 0;
 };
 
 } // namespace ouly
@@ -5,6 +5,7 @@
 #include "ouly/allocators/allocator.hpp"
 #include "ouly/allocators/detail/ca_structs.hpp"
 #include "ouly/allocators/detail/memory_stats.hpp"
+#include "ouly/allocators/detail/simd_search.hpp"
 #include "ouly/containers/detail/vlist.hpp"
 #include "ouly/utility/config.hpp"
 #include <cstdint>
@@ -142,21 +143,81 @@ public:
       return ca_allocation{.offset_ = 0, .id_ = block, .arena_ = arena};
     }
 
-    ca_allocation al = try_allocate(size);
+    ca_allocation al = allocate_free(size);
 
     if (al.get_allocation_id() == allocation_id())
     {
       add_arena(vsize, manager);
-      al = try_allocate(size);
+      al = allocate_free(size);
     }
 
     return al;
   }
 
+  /**
+   * @brief Allocates a batch of blocks, out[i] receives the allocation of sizes[i].
+   *
+   * Requests are served in increasing size order, each one is searched for only past the free slot taken by the
+   * previous one, so the whole batch is a single pass over the sorted free sizes. The requests that do not fit share
+   * one new arena sized for all of them, requests of at least the arena size still get a dedicated arena each.
+   */
+  template <CoalescingMemoryManager M>
+  void allocate_many(std::span<size_type const> sizes, M& manager, std::span<ca_allocation> out)
+  {
+    assert(out.size() >= sizes.size());
+    sort_batch(sizes);
+    auto const count  = static_cast<uint32_t>(batch_order_.size());
+    auto const served = allocate_sorted(sizes, out, 0, count);
+
+    size_type shared = 0;
+    auto      last   = served;
+    for (; last < count && sizes[batch_order_[last]] < arena_size_; ++last)
+    {
+      shared += sizes[batch_order_[last]];
+    }
+
+    for (auto i = last; i < count; ++i)
+    {
+      auto                  size    = sizes[batch_order_[i]];
+      [[maybe_unused]] auto measure = statistics::report_allocate(size);
+      auto [arena, block]           = add_arena_filled(size, manager);
+      out[batch_order_[i]]          = ca_allocation{.offset_ = 0, .id_ = block, .arena_ = arena};
+    }
+
+    if (last != served)
+    {
+      add_arena(shared, manager);
+      [[maybe_unused]] auto done = allocate_sorted(sizes, out, served, last);
+      assert(done == last);
+    }
+  }
+
+  /**
+   * @brief Allocates from the free blocks of the existing arenas only, never adds an arena.
+   * @return the allocation, with an allocation_id() id if no free block is large enough
+   */
+  [[nodiscard]] auto try_allocate(size_type size) -> ca_allocation
+  {
+    if (get_max_free_size() < size)
+    {
+      return {};
+    }
+    [[maybe_unused]] auto measure = statistics::report_allocate(size);
+    return allocate_free(size);
+  }
+
+  /** @brief Size of the largest free block, 0 when there is none */
+  [[nodiscard]] auto get_max_free_size() const noexcept -> size_type
+  {
+    return sizes_.empty() ? 0 : sizes_.back();
+  }
+
   /** @brief Dellocate an allocation. The manager must be provided for removal of arenas_. */
   template <CoalescingMemoryManager M>
   void deallocate(allocation_id id, M& manager)
   {
+    [[maybe_unused]] auto measure = statistics::report_deallocate(get_size(id));
+
     auto aa = deallocate(id);
     if (aa != arena_id())
     {
@@ -164,6 +225,19 @@ public:
     }
   }
 
+  /**
+   * @brief Deallocates a batch of allocations. Blocks are released in arena and offset order, and every run of
+   * adjacent blocks in the batch is merged into one free block before it is coalesced with its neighbours.
+   */
+  template <CoalescingMemoryManager M>
+  void deallocate_many(std::span<allocation_id const> ids, M& manager)
+  {
+    for (auto arena : deallocate_sorted(ids))
+    {
+      manager.remove(arena);
+    }
+  }
+
   void validate_integrity() const;
 
   [[nodiscard]] auto get_offsets() const noexcept -> std::span<allocation_size_type const>
@@ -215,27 +289,7 @@ private:
 
   static auto mini2(size_type const* it, size_t size, size_type key) noexcept
   {
-    while (true)
-    {
-      {
-        const size_type* const middle = it + (size >> 1);
-        size                          = (size + 1) >> 1;
-        it                            = *middle < key ? middle : it;
-      };
-      {
-        const size_type* const middle = it + (size >> 1);
-        size                          = (size + 1) >> 1;
-        it                            = *middle < key ? middle : it;
-      };
-      if (size <= 2)
-      {
-        break;
-      }
-    }
-
-    it += static_cast<size_type>(size > 1 && (*it < key));
-    it += static_cast<size_type>(size > 0 && (*it < key));
-    return it;
+    return ouly::detail::simd_lower_bound(it, size, key);
   }
 
   static auto mini2_it(size_type const* it, size_t s, size_type key) noexcept
@@ -264,7 +318,7 @@ private:
     return sz;
   }
 
-  auto try_allocate(size_type size) -> ca_allocation
+  auto allocate_free(size_type size) -> ca_allocation
   {
     if (sizes_.empty() || sizes_.back() < size)
     {
@@ -276,6 +330,18 @@ private:
      .offset_ = block_entries_.offsets_[id], .id_ = {.id_ = id}, .arena_ = {.id_ = block_entries_.arenas_[id]}};
   }
 
+  /**
+   * @brief Fills batch_order_ with the indices of sizes in increasing size order
+   */
+  void sort_batch(std::span<size_type const> sizes);
+  /**
+   * @brief Serves the requests batch_order_[first, last) from the free blocks, stops at the first one that does not fit
+   * @return index in batch_order_ of the first request not served
+   */
+  auto allocate_sorted(std::span<size_type const> sizes, std::span<ca_allocation> out, uint32_t first, uint32_t last)
+   -> uint32_t;
+  auto deallocate_sorted(std::span<allocation_id const> ids) -> std::span<arena_id const>;
+
   void reinsert_left(size_t of, size_type size, std::uint32_t node);
   void reinsert_right(size_t of, size_type size, std::uint32_t node);
   auto commit(size_type size, size_type const* found) -> uint32_t;
@@ -288,6 +354,10 @@ private:
   std::vector<size_type> sizes_;
   std::vector<uint32_t>  free_ordering_;
 
+  // Scratch of the batch calls
+  std::vector<uint32_t> batch_order_;
+  std::vector<arena_id> batch_arenas_;
+
   size_type arena_size_ = 0;
 };
 
@@ -0,0 +1,277 @@
+#pragma once
+
+#include "ouly/allocators/default_allocator.hpp"
+#include "ouly/allocators/detail/custom_allocator.hpp"
+#include "ouly/allocators/detail/memory_stats.hpp"
+#include "ouly/allocators/detail/pool_defs.hpp"
+#include "ouly/utility/config.hpp"
+#include "ouly/utility/tagged_ptr.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+namespace ouly
+{
+
+struct concurrent_pool_allocator_tag
+{};
+
+/**
+ * @brief A pool allocator that can be used from any number of threads, with frees coming from a different thread than
+ * the allocation.
+ *
+ * Blocks are multiples of the atom size, up to atom_count atoms, and every block size has its own lock-free free list,
+ * a Treiber stack whose head is a @ref tagged_ptr to avoid ABA. New blocks are bumped out of the current chunk of
+ * atom_count atoms with a single fetch_add, only replacing an exhausted chunk takes a lock. Blocks are not split or
+ * merged between sizes, memory is returned to the underlying allocator when the pool is destroyed. Requests larger than
+ * atom_count atoms go to the underlying allocator directly.
+ *
+ * Options:
+ * - cfg::atom_size, cfg::atom_count: as for pool_allocator
+ * - cfg::underlying_allocator: allocator for chunks and large requests
+ * - cfg::compute_atomic_stats: statistics, cfg::compute_stats is not thread safe and not accepted
+ */
+template <typename Config = ouly::config<>>
+class concurrent_pool_allocator : ouly::detail::statistics<concurrent_pool_allocator_tag, Config>
+{
+  static_assert(ouly::detail::stats_impl<Config>::option != ouly::cfg::memory_stat_type::e_compute,
+                "concurrent_pool_allocator needs thread safe statistics, use cfg::compute_atomic_stats");
+
+public:
+  using tag                                = concurrent_pool_allocator_tag;
+  using statistics                         = ouly::detail::statistics<concurrent_pool_allocator_tag, Config>;
+  static constexpr auto default_atom_size  = ouly::detail::atom_size<Config>::value;
+  static constexpr auto default_atom_count = ouly::detail::atom_count<Config>::value;
+  using underlying_allocator               = ouly::detail::underlying_allocator_t<Config>;
+  using size_type                          = typename underlying_allocator::size_type;
+  using address                            = typename underlying_allocator::address;
+
+  concurrent_pool_allocator() noexcept
+      : concurrent_pool_allocator(static_cast<size_type>(default_atom_size),
+                                  static_cast<size_type>(default_atom_count))
+  {}
+
+  concurrent_pool_allocator(size_type i_atom_size, size_type i_atom_count)
+      : free_lists_(std::make_unique<free_list[]>(i_atom_count)), k_atom_size_(i_atom_size),
+        k_atom_count_(i_atom_count)
+  {
+    assert(i_atom_size >= sizeof(void*) && "Atoms must be able to hold a pointer");
+  }
+
+  concurrent_pool_allocator(concurrent_pool_allocator const&)                    = delete;
+  concurrent_pool_allocator(concurrent_pool_allocator&&)                         = delete;
+  auto operator=(concurrent_pool_allocator const&) -> concurrent_pool_allocator& = delete;
+  auto operator=(concurrent_pool_allocator&&) -> concurrent_pool_allocator&      = delete;
+
+  ~concurrent_pool_allocator() noexcept
+  {
+    auto* it = chunks_;
+    while (it != nullptr)
+    {
+      auto* next = it->next_;
+      underlying_allocator::deallocate(it, chunk_size());
+      it = next;
+    }
+  }
+
+  constexpr static auto null() -> address
+  {
+    return underlying_allocator::null();
+  }
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] auto allocate(size_type size_value, Alignment alignment = {}) -> address
+  {
+    constexpr auto alignment_value = (size_t)alignment;
+    auto           fixup           = alignment_value - 1;
+    bool           padded          = alignment_value && ((k_atom_size_ < alignment_value) || (k_atom_size_ & fixup));
+    if (padded)
+    {
+      size_value += alignment_value + 4;
+    }
+
+    [[maybe_unused]] auto measure = statistics::report_allocate(size_value);
+    size_type             i_count = (size_value + k_atom_size_ - 1) / k_atom_size_;
+    if (i_count > k_atom_count_)
+    {
+      return underlying_allocator::allocate(size_value, alignment);
+    }
+
+    address ret_value = pop(i_count);
+    if (ret_value == nullptr)
+    {
+      ret_value = bump(i_count);
+    }
+
+    if (padded)
+    {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto pointer = reinterpret_cast<std::uintptr_t>(ret_value);
+      auto ret     = ((pointer + 4 + static_cast<std::uintptr_t>(fixup)) & ~static_cast<std::uintptr_t>(fixup));
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, performance-no-int-to-ptr)
+      *(reinterpret_cast<std::uint32_t*>(ret) - 1) = static_cast<std::uint32_t>(ret - pointer);
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, performance-no-int-to-ptr)
+      return reinterpret_cast<address>(ret);
+    }
+    return ret_value;
+  }
+
+  template <typename Alignment = alignment<>>
+  void deallocate(address i_ptr, size_type size_value, Alignment alignment = {})
+  {
+    constexpr auto alignment_value = (size_t)alignment;
+    auto           fixup           = alignment_value - 1;
+    address        orig_ptr        = i_ptr;
+    if (alignment_value && ((k_atom_size_ < alignment_value) || (k_atom_size_ & fixup)))
+    {
+      size_value += alignment_value + 4;
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      std::uint32_t off_by = *(reinterpret_cast<std::uint32_t*>(i_ptr) - 1);
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      i_ptr = reinterpret_cast<address>(reinterpret_cast<std::uint8_t*>(i_ptr) - off_by);
+    }
+
+    [[maybe_unused]] auto measure = statistics::report_deallocate(size_value);
+    size_type             i_count = (size_value + k_atom_size_ - 1) / k_atom_size_;
+    if (i_count > k_atom_count_)
+    {
+      underlying_allocator::deallocate(orig_ptr, size_value, alignment);
+      return;
+    }
+
+    push(i_ptr, i_count);
+  }
+
+  [[nodiscard]] auto get_atom_size() const noexcept -> size_type
+  {
+    return k_atom_size_;
+  }
+
+  [[nodiscard]] auto get_atom_count() const noexcept -> size_type
+  {
+    return k_atom_count_;
+  }
+
+  /**
+   * @brief Number of chunks allocated so far
+   */
+  [[nodiscard]] auto get_chunk_count() const noexcept -> uint32_t
+  {
+    return chunk_count_.load(std::memory_order_relaxed);
+  }
+
+  using statistics::print;
+
+private:
+  struct free_node
+  {
+    std::atomic<free_node*> next_ = nullptr;
+  };
+
+  using head_ptr = ouly::tagged_ptr<free_node>;
+
+  struct free_list
+  {
+    alignas(ouly::detail::cache_line_size) std::atomic<head_ptr> head_ = head_ptr(nullptr, 0);
+  };
+
+  struct chunk
+  {
+    std::atomic<size_type> used_ = 0;
+    chunk*                 next_ = nullptr;
+  };
+
+  static constexpr size_type chunk_header_size =
+   ((sizeof(chunk) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t)) * alignof(std::max_align_t);
+
+  [[nodiscard]] auto chunk_size() const noexcept -> size_type
+  {
+    return chunk_header_size + (k_atom_count_ * k_atom_size_);
+  }
+
+  static auto chunk_data(chunk* c) noexcept -> std::uint8_t*
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<std::uint8_t*>(c) + chunk_header_size;
+  }
+
+  auto pop(size_type i_count) noexcept -> address
+  {
+    auto& list = free_lists_[i_count - 1].head_;
+    auto  head = list.load(std::memory_order_acquire);
+    while (head.get_ptr() != nullptr)
+    {
+      // Nodes are never unmapped while the pool lives, a stale read is caught by the tag
+      auto next = head_ptr(head.get_ptr()->next_.load(std::memory_order_relaxed), head.get_next_tag());
+      if (list.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        return head.get_ptr();
+      }
+    }
+    return nullptr;
+  }
+
+  void push(address i_ptr, size_type i_count) noexcept
+  {
+    auto& list = free_lists_[i_count - 1].head_;
+    auto* node = std::construct_at(static_cast<free_node*>(i_ptr));
+    auto  head = list.load(std::memory_order_relaxed);
+    while (true)
+    {
+      node->next_.store(head.get_ptr(), std::memory_order_relaxed);
+      if (list.compare_exchange_weak(head, head_ptr(node, head.get_next_tag()), std::memory_order_release,
+                                     std::memory_order_relaxed))
+      {
+        return;
+      }
+    }
+  }
+
+  auto bump(size_type i_count) -> address
+  {
+    while (true)
+    {
+      auto* current = current_.load(std::memory_order_acquire);
+      if (current != nullptr)
+      {
+        auto offset = current->used_.fetch_add(i_count, std::memory_order_relaxed);
+        if (offset + i_count <= k_atom_count_)
+        {
+          return chunk_data(current) + (offset * k_atom_size_);
+        }
+        // Only the request that crossed the end sees a partial tail, hand it out as single atoms
+        for (; offset < k_atom_count_; ++offset)
+        {
+          push(chunk_data(current) + (offset * k_atom_size_), 1);
+        }
+      }
+      grow(current);
+    }
+  }
+
+  void grow(chunk* exhausted)
+  {
+    auto lck = std::scoped_lock(grow_lock_);
+    if (current_.load(std::memory_order_relaxed) != exhausted)
+    {
+      return;
+    }
+    auto* c  = std::construct_at(static_cast<chunk*>(underlying_allocator::allocate(chunk_size())));
+    c->next_ = chunks_;
+    chunks_  = c;
+    chunk_count_.fetch_add(1, std::memory_order_relaxed);
+    statistics::report_new_arena();
+    current_.store(c, std::memory_order_release);
+  }
+
+  std::unique_ptr<free_list[]> free_lists_;
+  std::atomic<chunk*>          current_      = nullptr;
+  std::atomic_uint32_t         chunk_count_  = 0;
+  std::mutex                   grow_lock_;
+  chunk*                       chunks_       = nullptr;
+  size_type                    k_atom_size_  = {};
+  size_type                    k_atom_count_ = {};
+};
+
+} // namespace ouly
@@ -14,6 +14,16 @@ struct track_memory
   static constexpr bool track_memory_v = true;
 };
 
+/**
+ * @brief Tracks one allocation per BytesPerSample allocated bytes on average instead of every allocation, with a lock
+ * free table and a backtrace per sample only, cheap enough to stay enabled in production
+ */
+template <std::size_t BytesPerSample = 512UL * 1024UL>
+struct sample_memory
+{
+  static constexpr std::size_t sample_memory_v = BytesPerSample;
+};
+
 template <typename T>
 struct debug_tracer
 {
@@ -56,6 +66,15 @@ struct atom_size_npt
   static constexpr std::size_t atom_size_v = N;
 };
 
+/**
+ * @brief Number of atoms a thread cache keeps per magazine, refills and flushes move half of it at a time
+ */
+template <std::size_t N>
+struct magazine_size
+{
+  static constexpr std::size_t magazine_size_v = N;
+};
+
 template <std::size_t Value>
 struct granularity
 {
@@ -127,6 +146,15 @@ struct compute_atomic_stats
   static constexpr ouly::cfg::memory_stat_type compute_stats_v = ouly::cfg::memory_stat_type::e_compute_atomic;
 };
 
+/**
+ * @brief Collects log2 histograms of the allocation sizes and of the allocation/deallocation latency in tsc_clock
+ * ticks, see memory_telemetry. Enables compute_stats unless compute_atomic_stats is also given.
+ */
+struct compute_histograms
+{
+  static constexpr bool compute_histograms_v = true;
+};
+
 struct bsearch_min0
 {
   static constexpr int bsearch_algo = 0;
@@ -139,5 +167,29 @@ struct bsearch_min2
 {
   static constexpr int bsearch_algo = 2;
 };
+/**
+ * @brief Binary search that finishes with a vectorized pass over the last cache line, see OULY_USE_SSE2/OULY_USE_AVX
+ */
+struct bsearch_simd
+{
+  static constexpr int bsearch_algo = 3;
+};
+
+enum class vm_page_mode : uint8_t
+{
+  e_default,
+  e_transparent_huge,
+  e_huge_tlb
+};
+
+/**
+ * @brief Page size used by virtual memory backed allocators. e_transparent_huge advises the kernel to back the range
+ * with huge pages, e_huge_tlb maps explicit huge pages and falls back to regular pages when none are available.
+ */
+template <vm_page_mode Mode>
+struct page_mode
+{
+  static constexpr vm_page_mode page_mode_v = Mode;
+};
 
 } // namespace ouly::cfg
@@ -34,15 +34,12 @@ struct allocator_traits<default_allocator_tag>
 // ----------------- Allocator Config -----------------
 
 template <typename Config = ouly::config<>>
-struct OULY_EMPTY_BASES default_allocator
-    : ouly::detail::memory_tracker<default_allocator_tag, ouly::detail::debug_tracer_t<Config>,
-                                   ouly::detail::HasTrackMemory<Config>>
+struct OULY_EMPTY_BASES default_allocator : ouly::detail::tracker_t<default_allocator_tag, Config>
 {
   using tag       = default_allocator_tag;
   using address   = void*;
   using size_type = ouly::detail::choose_size_t<std::size_t, Config>;
-  using tracker   = ouly::detail::memory_tracker<default_allocator_tag, ouly::detail::debug_tracer_t<Config>,
-                                                 ouly::detail::HasTrackMemory<Config>>;
+  using tracker   = ouly::detail::tracker_t<default_allocator_tag, Config>;
 
   static constexpr auto align = ouly::detail::min_alignment_v<Config>;
 
@@ -33,8 +33,10 @@ struct strategy<T>
 
 struct defrag_stats
 {
-  std::uint32_t total_mem_move_merge_ = 0;
-  std::uint32_t total_arenas_removed_ = 0;
+  std::uint32_t total_mem_move_merge_    = 0;
+  std::uint32_t total_arenas_removed_    = 0;
+  // Fragmented free size left after the last defragment_step
+  std::uint64_t remaining_fragmentation_ = 0;
 
   void report_defrag_mem_move_merge()
   {
@@ -46,14 +48,19 @@ struct defrag_stats
     total_arenas_removed_++;
   }
 
+  void report_defrag_remaining(std::uint64_t size)
+  {
+    remaining_fragmentation_ = size;
+  }
+
   [[nodiscard]] auto print() const -> std::string
   {
 #ifndef NDEBUG
 #ifdef __clang__
     return "";
 #else
-    return std::format("Defrag memory move merges: {}\nDefrag arenas removed: {}", total_mem_move_merge_,
-                       total_arenas_removed_);
+    return std::format("Defrag memory move merges: {}\nDefrag arenas removed: {}\nDefrag remaining fragmentation: {}",
+                       total_mem_move_merge_, total_arenas_removed_, remaining_fragmentation_);
 #endif
 #else
     return "";
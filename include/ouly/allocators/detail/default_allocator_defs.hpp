@@ -28,6 +28,11 @@ struct is_static<default_allocator_tag>
 template <typename O>
 concept HasTrackMemory = O::track_memory_v;
 
+template <typename O>
+concept HasSampleMemory = requires {
+  { O::sample_memory_v } -> std::convertible_to<std::size_t>;
+};
+
 template <typename O>
 concept HasDebugTracer = requires { typename O::debug_tracer_t; };
 
@@ -54,6 +59,21 @@ struct debug_tracer<T>
 template <typename T>
 using debug_tracer_t = typename debug_tracer<T>::type;
 
+template <typename Tag, typename Config>
+struct tracker
+{
+  using type = memory_tracker<Tag, debug_tracer_t<Config>, HasTrackMemory<Config>>;
+};
+
+template <typename Tag, HasSampleMemory Config>
+struct tracker<Tag, Config>
+{
+  using type = sampling_memory_tracker<Tag, debug_tracer_t<Config>, Config::sample_memory_v>;
+};
+
+template <typename Tag, typename Config>
+using tracker_t = typename tracker<Tag, Config>::type;
+
 template <typename T>
 struct min_alignment
 {
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "ouly/allocators/config.hpp"
+#include "ouly/allocators/memory_telemetry.hpp"
 #include "ouly/reflection/type_name.hpp"
 #include "ouly/utility/common.hpp"
+#include "ouly/utility/tsc_clock.hpp"
+#include <array>
 #include <atomic>
+#include <bit>
 #include <chrono>
 #include <cstdint>
+#include <type_traits>
 
 namespace ouly::detail
 {
@@ -13,6 +18,9 @@ template <typename T>
 concept HasComputeStats = T::compute_stats_v == ouly::cfg::memory_stat_type::e_compute ||
                           T::compute_stats_v == ouly::cfg::memory_stat_type::e_compute_atomic;
 
+template <typename T>
+concept HasComputeHistograms = T::compute_histograms_v;
+
 template <typename T>
 concept HasBaseStats = requires { typename T::base_stat_type; };
 
@@ -51,6 +59,19 @@ struct stats_impl<T>
   static constexpr ouly::cfg::memory_stat_type option = T::compute_stats_v;
 };
 
+template <typename T>
+  requires(HasComputeHistograms<T> && !HasComputeStats<T>)
+struct stats_impl<T>
+{
+  static constexpr ouly::cfg::memory_stat_type option = ouly::cfg::memory_stat_type::e_compute;
+};
+
+template <typename Config>
+constexpr bool has_histograms_v = false;
+
+template <HasComputeHistograms Config>
+constexpr bool has_histograms_v<Config> = true;
+
 struct timer_t
 {
   struct scoped
@@ -95,7 +116,110 @@ struct timer_t
   uint64_t elapsed_time_ = 0;
 };
 
-template <typename Tag, typename Base, ouly::cfg::memory_stat_type = ouly::cfg::memory_stat_type::e_none>
+/**
+ * @brief Histogram of the bit width of the recorded values, see memory_telemetry
+ */
+template <typename Counter>
+struct log2_histogram
+{
+  std::array<Counter, memory_telemetry::bucket_count> buckets_ = {};
+
+  void record(std::uint64_t value) noexcept
+  {
+    if constexpr (std::is_integral_v<Counter>)
+    {
+      buckets_[std::bit_width(value)]++;
+    }
+    else
+    {
+      buckets_[std::bit_width(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void copy_to(memory_telemetry::histogram& dst) const noexcept
+  {
+    for (std::uint32_t i = 0; i < memory_telemetry::bucket_count; ++i)
+    {
+      dst[i] = buckets_[i];
+    }
+  }
+};
+
+/**
+ * @brief Times a call with timer_t and records its duration in tsc_clock ticks into a latency histogram
+ */
+template <typename Counter>
+struct latency_scope
+{
+  latency_scope(timer_t& t, log2_histogram<Counter>& h) noexcept : timer_(t), histogram_(&h), start_(tsc_clock::now())
+  {}
+  latency_scope(latency_scope const&) = delete;
+  latency_scope(latency_scope&& other) noexcept
+      : timer_(std::move(other.timer_)), histogram_(other.histogram_), start_(other.start_)
+  {
+    other.histogram_ = nullptr;
+  }
+  auto operator=(latency_scope const&) -> latency_scope& = delete;
+  auto operator=(latency_scope&&) -> latency_scope&      = delete;
+
+  ~latency_scope()
+  {
+    if (histogram_ != nullptr)
+    {
+      histogram_->record(tsc_clock::now() - start_);
+    }
+  }
+
+  timer_t::scoped          timer_;
+  log2_histogram<Counter>* histogram_ = nullptr;
+  std::uint64_t            start_     = 0;
+};
+
+struct no_histograms
+{
+  static auto allocate_scope(std::size_t /*size*/, timer_t& t) -> timer_t::scoped
+  {
+    return {t};
+  }
+  static auto deallocate_scope(timer_t& t) -> timer_t::scoped
+  {
+    return {t};
+  }
+  static void export_to(memory_telemetry& /*out*/) {}
+};
+
+/**
+ * @brief Size and latency histograms collected with cfg::compute_histograms
+ */
+template <typename Counter>
+struct allocation_histograms
+{
+  log2_histogram<Counter> sizes_;
+  log2_histogram<Counter> allocation_ticks_;
+  log2_histogram<Counter> deallocation_ticks_;
+
+  auto allocate_scope(std::size_t size, timer_t& t) -> latency_scope<Counter>
+  {
+    sizes_.record(size);
+    return {t, allocation_ticks_};
+  }
+
+  auto deallocate_scope(timer_t& t) -> latency_scope<Counter>
+  {
+    return {t, deallocation_ticks_};
+  }
+
+  void export_to(memory_telemetry& out) const
+  {
+    sizes_.copy_to(out.sizes_);
+    allocation_ticks_.copy_to(out.allocation_ticks_);
+    deallocation_ticks_.copy_to(out.deallocation_ticks_);
+    out.ticks_per_us_ = tsc_clock::ticks_per_us();
+  }
+};
+
+template <typename Tag, typename Base, ouly::cfg::memory_stat_type = ouly::cfg::memory_stat_type::e_none,
+          bool Histograms = false>
 struct statistics_impl
 {
 
@@ -112,15 +236,20 @@ struct statistics_impl
   {
     return std::false_type{};
   }
+  static void report_merge(std::uint64_t /*allocations*/, std::uint64_t /*deallocations*/, std::size_t /*allocated*/,
+                           std::size_t /*deallocated*/)
+  {}
 
   [[nodiscard]] auto get_arenas_allocated() const -> std::uint32_t
   {
     return 0;
   }
+
+  static void export_telemetry(memory_telemetry& /*out*/) {}
 };
 
-template <typename TagArg, typename Base>
-struct statistics_impl<TagArg, Base, ouly::cfg::memory_stat_type::e_compute_atomic> : public Base
+template <typename TagArg, typename Base, bool Histograms>
+struct statistics_impl<TagArg, Base, ouly::cfg::memory_stat_type::e_compute_atomic, Histograms> : public Base
 {
   statistics_impl() noexcept = default;
   statistics_impl(const statistics_impl& /*unused*/) noexcept {}
@@ -144,6 +273,9 @@ struct statistics_impl<TagArg, Base, ouly::cfg::memory_stat_type::e_compute_atom
   timer_t              deallocation_timing_;
   bool                 stats_printed_ = false;
 
+  using histograms_t = std::conditional_t<Histograms, allocation_histograms<std::atomic_uint64_t>, no_histograms>;
+  [[no_unique_address]] histograms_t histograms_;
+
   ~statistics_impl() noexcept
   {
     print_to_debug();
@@ -199,28 +331,55 @@ struct statistics_impl<TagArg, Base, ouly::cfg::memory_stat_type::e_compute_atom
     arenas_allocated_ += count;
   }
 
-  [[nodiscard]] auto report_allocate(std::size_t size) -> timer_t::scoped
+  [[nodiscard]] auto report_allocate(std::size_t size)
   {
     allocation_count_++;
-    allocation_ += size;
-    peak_allocation_ = std::max<std::size_t>(allocation_.load(), peak_allocation_.load());
-    return timer_t::scoped(allocation_timing_);
+    update_peak(allocation_ += size);
+    return histograms_.allocate_scope(size, allocation_timing_);
   }
-  [[nodiscard]] auto report_deallocate(std::size_t size) -> timer_t::scoped
+  [[nodiscard]] auto report_deallocate(std::size_t size)
   {
     deallocation_count_++;
     allocation_ -= size;
-    return timer_t::scoped(deallocation_timing_);
+    return histograms_.deallocate_scope(deallocation_timing_);
+  }
+
+  /**
+   * @brief Folds counters collected elsewhere, for example by a thread cache, into these statistics
+   */
+  void report_merge(std::uint64_t allocations, std::uint64_t deallocations, std::size_t allocated,
+                    std::size_t deallocated)
+  {
+    allocation_count_ += allocations;
+    deallocation_count_ += deallocations;
+    update_peak(allocation_ += allocated);
+    allocation_ -= deallocated;
+  }
+
+  /**
+   * @brief Raises the peak to value, a plain store could lower a peak raised concurrently by another thread
+   */
+  void update_peak(std::uint64_t value) noexcept
+  {
+    auto peak = peak_allocation_.load(std::memory_order_relaxed);
+    while (peak < value && !peak_allocation_.compare_exchange_weak(peak, value, std::memory_order_relaxed))
+    {
+    }
   }
 
   [[nodiscard]] auto get_arenas_allocated() const -> std::uint32_t
   {
     return arenas_allocated_.load();
   }
+
+  void export_telemetry(memory_telemetry& out) const
+  {
+    histograms_.export_to(out);
+  }
 };
 
-template <typename TagArg, typename Base>
-struct statistics_impl<TagArg, Base, ouly::cfg::memory_stat_type::e_compute> : public Base
+template <typename TagArg, typename Base, bool Histograms>
+struct statistics_impl<TagArg, Base, ouly::cfg::memory_stat_type::e_compute, Histograms> : public Base
 {
 
   statistics_impl() noexcept                                     = default;
@@ -238,6 +397,9 @@ struct statistics_impl<TagArg, Base, ouly::cfg::memory_stat_type::e_compute> : p
   timer_t  deallocation_timing_;
   bool     stats_printed_ = false;
 
+  using histograms_t = std::conditional_t<Histograms, allocation_histograms<std::uint64_t>, no_histograms>;
+  [[no_unique_address]] histograms_t histograms_;
+
   ~statistics_impl() noexcept
   {
     print_to_debug();
@@ -292,36 +454,57 @@ struct statistics_impl<TagArg, Base, ouly::cfg::memory_stat_type::e_compute> : p
     arenas_allocated_ += count;
   }
 
-  [[nodiscard]] auto report_allocate(std::size_t size) -> timer_t::scoped
+  [[nodiscard]] auto report_allocate(std::size_t size)
   {
     allocation_count_++;
     allocation_ += size;
     peak_allocation_ = std::max<std::size_t>(allocation_, peak_allocation_);
-    return timer_t::scoped(allocation_timing_);
+    return histograms_.allocate_scope(size, allocation_timing_);
   }
-  [[nodiscard]] auto report_deallocate(std::size_t size) -> timer_t::scoped
+  [[nodiscard]] auto report_deallocate(std::size_t size)
   {
     deallocation_count_++;
     allocation_ -= size;
-    return timer_t::scoped(deallocation_timing_);
+    return histograms_.deallocate_scope(deallocation_timing_);
+  }
+
+  /**
+   * @brief Folds counters collected elsewhere, for example by a thread cache, into these statistics
+   */
+  void report_merge(std::uint64_t allocations, std::uint64_t deallocations, std::size_t allocated,
+                    std::size_t deallocated)
+  {
+    allocation_count_ += allocations;
+    deallocation_count_ += deallocations;
+    allocation_ += allocated;
+    peak_allocation_ = std::max<std::size_t>(allocation_, peak_allocation_);
+    allocation_ -= deallocated;
   }
 
   [[nodiscard]] auto get_arenas_allocated() const -> std::uint32_t
   {
     return arenas_allocated_;
   }
+
+  void export_telemetry(memory_telemetry& out) const
+  {
+    histograms_.export_to(out);
+  }
 };
 
 template <typename Tag, typename Config = ouly::config<>>
-struct statistics
-    : public statistics_impl<Tag, ouly::detail::base_stat_type<Config>, ouly::detail::stats_impl<Config>::option>
+struct statistics : public statistics_impl<Tag, ouly::detail::base_stat_type<Config>,
+                                           ouly::detail::stats_impl<Config>::option, has_histograms_v<Config>>
 {
 
-  using super = statistics_impl<Tag, ouly::detail::base_stat_type<Config>, ouly::detail::stats_impl<Config>::option>;
+  using super = statistics_impl<Tag, ouly::detail::base_stat_type<Config>, ouly::detail::stats_impl<Config>::option,
+                                has_histograms_v<Config>>;
+  using super::export_telemetry;
   using super::get_arenas_allocated;
   using super::print;
   using super::report_allocate;
   using super::report_deallocate;
+  using super::report_merge;
   using super::report_new_arena;
 };
 
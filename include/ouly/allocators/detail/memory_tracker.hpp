@@ -1,11 +1,20 @@
 #pragma once
+#include "ouly/utility/config.hpp"
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <random>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 
 namespace ouly::detail
 {
@@ -108,7 +117,6 @@ struct memory_tracker_impl
       return;
     }
     std::unique_lock<std::mutex> ul(lock_);
-    std::stringstream            ss;
     if (i_data == ignore_first_)
     {
       ignore_first_ = reinterpret_cast<void*>(0x1); // NOLINT
@@ -117,12 +125,14 @@ struct memory_tracker_impl
     auto it = pointer_map_.find(i_data);
     if (it == pointer_map_.end())
     {
+      std::stringstream ss;
       ss << "\nInvalid memory free -> \n";
       ss << backtrace();
+      out_(ss.str());
+      return;
     }
     pointer_map_.erase(it);
     memory_counter_ -= i_size;
-    out_(ss.str());
   }
 
   std::unordered_map<void*, std::pair<std::size_t, std::reference_wrapper<const backtrace>>> pointer_map_;
@@ -163,4 +173,300 @@ struct memory_tracker<TagArg, DebugTracer, true>
     return i_data;
   }
 };
+
+/**
+ * @brief Lock free table of sampled allocations, sharded by pointer hash.
+ *
+ * Every shard is an open addressed array of slots probed linearly from the pointer hash. A slot is claimed with a
+ * compare exchange on its state, filled and then published, removal leaves a tombstone that later inserts reuse. A
+ * sample that finds no free slot within max_probe slots is dropped. Backtraces are only constructed, and so captured,
+ * when a sample is inserted.
+ */
+template <typename Backtrace>
+class sample_table
+{
+public:
+  static constexpr std::uint32_t shard_count     = 16;
+  static constexpr std::uint32_t slots_per_shard = 1024;
+  static constexpr std::uint32_t max_probe       = 32;
+
+  sample_table() : shards_(std::make_unique<shard[]>(shard_count)) {}
+
+  /**
+   * @brief Records ptr, capturing the backtrace of the caller
+   */
+  auto insert(void* ptr, std::size_t size) -> bool
+  {
+    auto [sh, start] = locate(ptr);
+    for (std::uint32_t i = 0; i < max_probe; ++i)
+    {
+      auto& s     = shards_[sh].slots_[(start + i) & (slots_per_shard - 1)];
+      auto  state = s.state_.load(std::memory_order_relaxed);
+      if ((state == e_empty || state == e_dead) &&
+          s.state_.compare_exchange_strong(state, e_busy, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        s.ptr_.store(ptr, std::memory_order_relaxed);
+        s.size_  = size;
+        s.trace_.emplace();
+        s.state_.store(e_live, std::memory_order_release);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Removes ptr if it was sampled, returns its size or 0
+   */
+  auto erase(void* ptr) -> std::size_t
+  {
+    auto [sh, start] = locate(ptr);
+    for (std::uint32_t i = 0; i < max_probe; ++i)
+    {
+      auto& s     = shards_[sh].slots_[(start + i) & (slots_per_shard - 1)];
+      auto  state = s.state_.load(std::memory_order_acquire);
+      if (state == e_empty)
+      {
+        return 0;
+      }
+      if (state == e_dead || s.ptr_.load(std::memory_order_relaxed) != ptr)
+      {
+        continue;
+      }
+      // A reader may hold the slot for a moment, wait for it to publish the slot again instead of taking it busy
+      state = e_live;
+      while (!s.state_.compare_exchange_weak(state, e_busy, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+        if (state != e_busy && state != e_live)
+        {
+          return 0;
+        }
+        state = e_live;
+      }
+      // The slot may have been reused for another pointer while it was looked at
+      if (s.ptr_.load(std::memory_order_relaxed) != ptr)
+      {
+        s.state_.store(e_live, std::memory_order_release);
+        continue;
+      }
+      auto size = s.size_;
+      s.state_.store(e_dead, std::memory_order_release);
+      count_.fetch_sub(1, std::memory_order_relaxed);
+      return size;
+    }
+    return 0;
+  }
+
+  /**
+   * @brief Calls fn(void* ptr, std::size_t size, Backtrace const&) for every recorded sample
+   */
+  template <typename Fn>
+  void for_each(Fn&& fn)
+  {
+    for (std::uint32_t sh = 0; sh < shard_count; ++sh)
+    {
+      for (auto& s : shards_[sh].slots_)
+      {
+        std::uint32_t state = e_live;
+        if (s.state_.compare_exchange_strong(state, e_busy, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+          fn(s.ptr_.load(std::memory_order_relaxed), s.size_, std::as_const(*s.trace_));
+          s.state_.store(e_live, std::memory_order_release);
+        }
+      }
+    }
+  }
+
+  [[nodiscard]] auto size() const noexcept -> std::uint32_t
+  {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  enum : std::uint32_t
+  {
+    e_empty,
+    e_busy,
+    e_live,
+    e_dead
+  };
+
+  struct slot
+  {
+    std::atomic_uint32_t     state_ = e_empty;
+    std::atomic<void*>       ptr_   = nullptr;
+    std::size_t              size_  = 0;
+    std::optional<Backtrace> trace_;
+  };
+
+  struct alignas(ouly::detail::cache_line_size) shard
+  {
+    std::array<slot, slots_per_shard> slots_;
+  };
+
+  static auto locate(void* ptr) noexcept -> std::pair<std::uint32_t, std::uint32_t>
+  {
+    constexpr std::uint64_t golden = 0x9E3779B97F4A7C15ULL;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto h = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(ptr)) * golden;
+    return {static_cast<std::uint32_t>(h >> 60U) & (shard_count - 1), static_cast<std::uint32_t>(h >> 32U)};
+  }
+
+  std::unique_ptr<shard[]> shards_; // NOLINT(cppcoreguidelines-avoid-c-arrays)
+  std::atomic_uint32_t     count_ = 0;
+};
+
+/**
+ * @brief Memory tracker that records one allocation per BytesPerSample allocated bytes on average.
+ *
+ * Every thread counts down a random number of bytes drawn from an exponential distribution with mean BytesPerSample,
+ * the allocation that crosses zero is sampled (Poisson sampling of the allocated bytes), so an allocation of s bytes is
+ * recorded with probability 1 - exp(-s / BytesPerSample) and large allocations are almost always seen. Only sampled
+ * allocations capture a backtrace and go into the sample_table, deallocations look the pointer up without locking.
+ * Samples left at exit are reported as possible leaks.
+ */
+template <typename TagArg, typename DebugTracer, std::size_t BytesPerSample>
+struct sampling_memory_tracker_impl
+{
+  using out_stream = typename DebugTracer::trace_output;
+  using backtrace  = typename DebugTracer::backtrace;
+
+  static_assert(BytesPerSample > 0, "Sampling interval must not be 0");
+
+  sampling_memory_tracker_impl() noexcept                                              = default;
+  sampling_memory_tracker_impl(const sampling_memory_tracker_impl&)                    = delete;
+  sampling_memory_tracker_impl(sampling_memory_tracker_impl&&)                         = delete;
+  auto operator=(const sampling_memory_tracker_impl&) -> sampling_memory_tracker_impl& = delete;
+  auto operator=(sampling_memory_tracker_impl&&) -> sampling_memory_tracker_impl&      = delete;
+
+  ~sampling_memory_tracker_impl()
+  {
+    if (samples_.size() != 0)
+    {
+      out_("\nPossible leaks (sampled)\n");
+      std::ostringstream stream;
+      samples_.for_each(
+       [&stream](void* ptr, std::size_t size, backtrace const& trace)
+       {
+         stream << "\n[" << ptr << "] for " << size << " bytes from\n" << trace;
+       });
+      out_(stream.str());
+    }
+  }
+
+  template <typename Arg>
+  void set_out_stream(Arg&& i_out)
+  {
+    out_ = std::forward<Arg>(i_out);
+  }
+
+  void when_allocate(void* i_data, std::size_t i_size)
+  {
+    auto& countdown = bytes_until_sample();
+    if (static_cast<std::int64_t>(i_size) < countdown)
+    {
+      countdown -= static_cast<std::int64_t>(i_size);
+      return;
+    }
+    countdown = next_sample_interval();
+    if (!samples_.insert(i_data, i_size))
+    {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void when_deallocate(void* i_data, [[maybe_unused]] std::size_t i_size)
+  {
+    if (samples_.size() != 0)
+    {
+      samples_.erase(i_data);
+    }
+  }
+
+  /**
+   * @brief Calls fn(void* ptr, std::size_t size, backtrace const&) for every live sample
+   */
+  template <typename Fn>
+  void for_each_sample(Fn&& fn)
+  {
+    samples_.for_each(std::forward<Fn>(fn));
+  }
+
+  /**
+   * @brief Live heap size estimated from the samples, each weighted by the inverse of its sampling probability
+   */
+  [[nodiscard]] auto estimated_live_bytes() -> double
+  {
+    double total = 0.0;
+    samples_.for_each(
+     [&total](void* /*ptr*/, std::size_t size, backtrace const& /*trace*/)
+     {
+       auto s = static_cast<double>(size);
+       total += s / (1.0 - std::exp(-s / static_cast<double>(BytesPerSample)));
+     });
+    return total;
+  }
+
+  [[nodiscard]] auto sample_count() const noexcept -> std::uint32_t
+  {
+    return samples_.size();
+  }
+
+  [[nodiscard]] auto dropped_samples() const noexcept -> std::uint64_t
+  {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  static auto get_instance() -> sampling_memory_tracker_impl&
+  {
+    static sampling_memory_tracker_impl instance;
+    return instance;
+  }
+
+private:
+  static auto bytes_until_sample() noexcept -> std::int64_t&
+  {
+    static thread_local std::int64_t countdown = next_sample_interval();
+    return countdown;
+  }
+
+  static auto next_sample_interval() noexcept -> std::int64_t
+  {
+    static thread_local std::minstd_rand gen(
+     static_cast<std::uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())));
+    std::exponential_distribution<double> interval(1.0 / static_cast<double>(BytesPerSample));
+    return static_cast<std::int64_t>(interval(gen)) + 1;
+  }
+
+  sample_table<backtrace> samples_;
+  std::atomic_uint64_t    dropped_ = 0;
+  out_stream              out_;
+};
+
+template <typename TagArg, typename DebugTracer, std::size_t BytesPerSample>
+struct sampling_memory_tracker
+{
+  using impl = sampling_memory_tracker_impl<TagArg, DebugTracer, BytesPerSample>;
+
+  template <typename Arg>
+  static void set_out_stream(Arg&& i_out)
+  {
+    impl::get_instance().set_out_stream(std::forward<Arg>(i_out));
+  }
+
+  static auto when_allocate(void* i_data, std::size_t i_size) -> void*
+  {
+    impl::get_instance().when_allocate(i_data, i_size);
+    return i_data;
+  }
+  static auto when_deallocate(void* i_data, std::size_t i_size) -> void*
+  {
+    if (i_data != nullptr)
+    {
+      impl::get_instance().when_deallocate(i_data, i_size);
+    }
+    return i_data;
+  }
+};
 } // namespace ouly::detail
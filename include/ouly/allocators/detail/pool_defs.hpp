@@ -1,3 +1,4 @@
+#pragma once
 
 #include <cstdint>
 #include <string>
@@ -22,6 +23,21 @@ struct atom_size
   static constexpr std::size_t value = 32;
 };
 
+template <typename O>
+concept HasMagazineSize = O::magazine_size_v > 1;
+
+template <typename T>
+struct magazine_size
+{
+  static constexpr std::size_t value = 64;
+};
+
+template <HasMagazineSize T>
+struct magazine_size<T>
+{
+  static constexpr std::size_t value = T::magazine_size_v;
+};
+
 template <HasAtomCount T>
 struct atom_count<T>
 {
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(OULY_USE_AVX)
+#include <immintrin.h>
+#elif defined(OULY_USE_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace ouly::detail
+{
+
+/**
+ * @brief Number of elements left for the final linear pass of simd_lower_bound, one vector, or two elements
+ * when no SIMD is enabled
+ */
+template <typename T>
+constexpr std::size_t simd_search_window =
+#if defined(OULY_USE_AVX)
+ 32 / sizeof(T);
+#elif defined(OULY_USE_SSE2)
+ sizeof(T) == 4 ? 4 : 2;
+#else
+ 2;
+#endif
+
+/**
+ * @brief Ranges larger than this many bytes are searched with prefetching, smaller ones are expected to be cached
+ */
+constexpr std::size_t simd_prefetch_bytes = 16384;
+
+/**
+ * @brief Counts the elements of [it, it + size) that are less than key
+ *
+ * With OULY_USE_SSE2 or OULY_USE_AVX, 32 bit values are compared 4 or 8 at a time, and 64 bit values 4 at a time with
+ * OULY_USE_AVX, by a signed compare of the values with their top bit flipped and a movemask. Other cases are counted
+ * by a branchless scalar loop.
+ */
+template <std::unsigned_integral T>
+inline auto count_less(T const* it, std::size_t size, T key) noexcept -> std::size_t
+{
+  std::size_t count = 0;
+  std::size_t i     = 0;
+#if defined(OULY_USE_AVX)
+  if constexpr (sizeof(T) == 4)
+  {
+    auto const bias = _mm256_set1_epi32(static_cast<int>(0x80000000U));
+    auto const k    = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(key)), bias);
+    for (; i + 8 <= size; i += 8)
+    {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto v    = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(it + i)), bias);
+      auto mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)));
+      count += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(mask)));
+    }
+  }
+  else if constexpr (sizeof(T) == 8)
+  {
+    auto const bias = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ULL));
+    auto const k    = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), bias);
+    for (; i + 4 <= size; i += 4)
+    {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto v    = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(it + i)), bias);
+      auto mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+      count += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(mask)));
+    }
+  }
+#elif defined(OULY_USE_SSE2)
+  if constexpr (sizeof(T) == 4)
+  {
+    auto const bias = _mm_set1_epi32(static_cast<int>(0x80000000U));
+    auto const k    = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(key)), bias);
+    for (; i + 4 <= size; i += 4)
+    {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto v    = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(it + i)), bias);
+      auto mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k)));
+      count += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(mask)));
+    }
+  }
+#endif
+  for (; i < size; ++i)
+  {
+    count += static_cast<std::size_t>(it[i] < key);
+  }
+  return count;
+}
+
+/**
+ * @brief Returns the first element of the sorted range [it, it + size) that is not less than key, or it + size.
+ *
+ * The range is halved without branches until it fits in simd_search_window elements, which are then compared in one
+ * pass by count_less. When SIMD is enabled and the range is larger than simd_prefetch_bytes, both possible midpoints of
+ * the next step are prefetched while the current one is being compared, which hides part of the cache misses.
+ */
+template <std::unsigned_integral T>
+inline auto simd_lower_bound(T const* it, std::size_t size, T key) noexcept -> T const*
+{
+#if defined(OULY_USE_AVX) || defined(OULY_USE_SSE2)
+  while (size > simd_prefetch_bytes / sizeof(T))
+  {
+    auto const half = size >> 1;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    _mm_prefetch(reinterpret_cast<char const*>(it + (half >> 1)), _MM_HINT_T0);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    _mm_prefetch(reinterpret_cast<char const*>(it + half + (half >> 1)), _MM_HINT_T0);
+    T const* const middle = it + half;
+    size                  = (size + 1) >> 1;
+    it                    = *middle < key ? middle : it;
+  }
+#endif
+  while (size > simd_search_window<T>)
+  {
+    T const* const middle = it + (size >> 1);
+    size                  = (size + 1) >> 1;
+    it                    = *middle < key ? middle : it;
+  }
+  return it + count_less(it, size, key);
+}
+
+} // namespace ouly::detail
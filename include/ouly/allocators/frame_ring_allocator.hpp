@@ -0,0 +1,296 @@
+#pragma once
+
+#include "ouly/allocators/default_allocator.hpp"
+#include "ouly/allocators/detail/custom_allocator.hpp"
+#include "ouly/allocators/detail/memory_stats.hpp"
+#include "ouly/scheduler/scheduler.hpp"
+#include "ouly/utility/config.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace ouly
+{
+
+struct frame_ring_allocator_tag
+{};
+
+/**
+ * @brief Transient allocator for data that lives until the frame that made it is retired.
+ *
+ * Memory is split in N regions used in turn, frame f allocates from region f % N. Before frame f begins, frame f - N
+ * must have been retired, at which point its region is reset as a whole: deallocate() does nothing, and the memory of a
+ * frame is reclaimed in one step no matter how many allocations it holds. Frames are retired in order, typically when
+ * the fence of the gpu work that reads the frame data is signalled, and retire() can be called from any thread.
+ *
+ * Every worker owns its own bump pointer and chunks in each region, so allocations never synchronize with other
+ * workers. A worker that runs out of space moves to its next chunk, or adds a chunk of max(size, chunk_size) bytes.
+ * Chunks are kept across frames, so once the busiest frames have been seen the allocator no longer allocates memory.
+ *
+ * Statistics are counted per worker and merged when the region is reset, and when the allocator is destroyed.
+ *
+ * @code
+ * ouly::frame_ring_allocator<3> frames(scheduler);
+ * auto frame = frames.begin_frame();
+ * ouly::parallel_for(
+ *  [&](auto& item, ouly::worker_context const& ctx)
+ *  {
+ *    item.commands_ = frames.allocate(ctx, item.command_size_);
+ *  },
+ *  items, ouly::default_workgroup_id);
+ * submit(frame, [&frames, frame] { frames.retire(frame); });
+ * @endcode
+ *
+ * Options:
+ * - cfg::underlying_allocator: allocator for the chunks
+ *
+ * @note allocate() is only safe to call from the worker passed to it, and begin_frame() must not run concurrently with
+ * allocations.
+ */
+template <std::uint32_t N, typename Config = ouly::config<>>
+class frame_ring_allocator : ouly::detail::statistics<frame_ring_allocator_tag, Config>
+{
+  static_assert(N > 0, "At least one region is required");
+
+public:
+  static constexpr std::uint32_t region_count       = N;
+  static constexpr std::uint32_t default_chunk_size = 1024 * 1024;
+
+  using tag                  = frame_ring_allocator_tag;
+  using statistics           = ouly::detail::statistics<frame_ring_allocator_tag, Config>;
+  using underlying_allocator = ouly::detail::underlying_allocator_t<Config>;
+  using size_type            = typename underlying_allocator::size_type;
+  using address              = typename underlying_allocator::address;
+
+  frame_ring_allocator() noexcept = default;
+  explicit frame_ring_allocator(std::uint32_t worker_count, size_type chunk_size = default_chunk_size)
+      : workers_(std::make_unique<worker_data[]>(worker_count)), worker_count_(worker_count), chunk_size_(chunk_size)
+  {}
+  explicit frame_ring_allocator(scheduler const& s, size_type chunk_size = default_chunk_size)
+      : frame_ring_allocator(s.get_worker_count(), chunk_size)
+  {}
+
+  frame_ring_allocator(frame_ring_allocator const&)                    = delete;
+  frame_ring_allocator(frame_ring_allocator&&)                         = delete;
+  auto operator=(frame_ring_allocator const&) -> frame_ring_allocator& = delete;
+  auto operator=(frame_ring_allocator&&) -> frame_ring_allocator&      = delete;
+
+  ~frame_ring_allocator() noexcept
+  {
+    for (std::uint32_t w = 0; w < worker_count_; ++w)
+    {
+      for (auto& r : workers_[w].regions_)
+      {
+        merge_stats(r);
+        for (auto const& c : r.chunks_)
+        {
+          underlying_allocator::deallocate(c.buffer_, c.size_);
+        }
+      }
+    }
+  }
+
+  constexpr static auto null() -> address
+  {
+    return underlying_allocator::null();
+  }
+
+  /**
+   * @brief Starts the next frame if the frame that last used its region has been retired.
+   * @return true if the frame was started, false if the caller has to wait for retire()
+   */
+  [[nodiscard]] auto try_begin_frame() -> bool
+  {
+    auto next = started_;
+    if (next >= N && retired_.load(std::memory_order_acquire) <= next - N)
+    {
+      return false;
+    }
+
+    region_ = static_cast<std::uint32_t>(next % N);
+    for (std::uint32_t w = 0; w < worker_count_; ++w)
+    {
+      auto& r = workers_[w].regions_[region_];
+      merge_stats(r);
+      r.chunk_  = 0;
+      r.offset_ = 0;
+    }
+    started_ = next + 1;
+    return true;
+  }
+
+  /**
+   * @brief Starts the next frame, waiting for the frame that last used its region to be retired
+   * @return the id of the frame, to be passed to retire()
+   */
+  auto begin_frame() -> std::uint64_t
+  {
+    while (!try_begin_frame())
+    {
+      std::this_thread::yield();
+    }
+    return started_ - 1;
+  }
+
+  /**
+   * @brief Marks the frame and all frames before it as retired, their regions may be reused
+   */
+  void retire(std::uint64_t frame) noexcept
+  {
+    assert(frame < started_ && "Frame was not started");
+    auto value = retired_.load(std::memory_order_relaxed);
+    while (value <= frame && !retired_.compare_exchange_weak(value, frame + 1, std::memory_order_release,
+                                                             std::memory_order_relaxed))
+    {
+    }
+  }
+
+  /**
+   * @brief Id of the frame being recorded, only valid after the first begin_frame()
+   */
+  [[nodiscard]] auto current_frame() const noexcept -> std::uint64_t
+  {
+    assert(started_ > 0);
+    return started_ - 1;
+  }
+
+  /**
+   * @brief Number of frames retired so far, frames [0, retired_count()) may no longer be read
+   */
+  [[nodiscard]] auto retired_count() const noexcept -> std::uint64_t
+  {
+    return retired_.load(std::memory_order_acquire);
+  }
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] auto allocate(worker_id worker, size_type size, Alignment align = {}) -> address
+  {
+    assert(started_ > 0 && "begin_frame was not called");
+    assert(worker.get_index() < worker_count_ &&
+           "Worker index out of range, was the allocator sized for this scheduler?");
+
+    auto& r     = workers_[worker.get_index()].regions_[region_];
+    auto  fixup = std::max<std::size_t>(static_cast<std::size_t>(align), 1) - 1;
+    for (;; ++r.chunk_, r.offset_ = 0)
+    {
+      if (r.chunk_ == r.chunks_.size() &&
+          !add_chunk(r, static_cast<size_type>(std::max<std::size_t>(size + fixup, chunk_size_))))
+      {
+        return null();
+      }
+
+      auto const& c     = r.chunks_[r.chunk_];
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto        start = reinterpret_cast<std::uintptr_t>(c.buffer_);
+      auto        begin = ((start + r.offset_ + fixup) & ~static_cast<std::uintptr_t>(fixup)) - start;
+      if (begin + size <= c.size_)
+      {
+        r.offset_ = static_cast<size_type>(begin + size);
+        r.allocations_++;
+        r.allocated_ += size;
+        return static_cast<std::uint8_t*>(c.buffer_) + begin;
+      }
+    }
+  }
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] auto allocate(worker_context const& ctx, size_type size, Alignment align = {}) -> address
+  {
+    return allocate(ctx.get_worker(), size, align);
+  }
+
+  /**
+   * @brief Does nothing, the memory is reclaimed when the frame's region is reset
+   */
+  template <typename Alignment = alignment<>>
+  void deallocate([[maybe_unused]] address data, [[maybe_unused]] size_type size,
+                  [[maybe_unused]] Alignment align = {}) noexcept
+  {}
+
+  /**
+   * @brief Total size of the chunks owned by all workers in all regions
+   */
+  [[nodiscard]] auto get_reserved_size() const noexcept -> std::size_t
+  {
+    std::size_t total = 0;
+    for (std::uint32_t w = 0; w < worker_count_; ++w)
+    {
+      for (auto const& r : workers_[w].regions_)
+      {
+        for (auto const& c : r.chunks_)
+        {
+          total += c.size_;
+        }
+      }
+    }
+    return total;
+  }
+
+  [[nodiscard]] auto get_worker_count() const noexcept -> std::uint32_t
+  {
+    return worker_count_;
+  }
+
+  using statistics::print;
+
+private:
+  struct chunk
+  {
+    address   buffer_ = nullptr;
+    size_type size_   = 0;
+  };
+
+  struct region
+  {
+    std::vector<chunk> chunks_;
+    std::size_t        chunk_       = 0;
+    size_type          offset_      = 0;
+    // Counters not yet merged into the allocator statistics
+    std::uint64_t      allocations_ = 0;
+    std::size_t        allocated_   = 0;
+    std::uint32_t      new_chunks_  = 0;
+  };
+
+  struct alignas(ouly::detail::cache_line_size) worker_data
+  {
+    std::array<region, N> regions_;
+  };
+
+  auto add_chunk(region& r, size_type size) -> bool
+  {
+    auto buffer = underlying_allocator::allocate(size);
+    if (buffer == underlying_allocator::null())
+    {
+      return false;
+    }
+    r.chunks_.push_back(chunk{.buffer_ = buffer, .size_ = size});
+    r.new_chunks_++;
+    return true;
+  }
+
+  void merge_stats(region& r)
+  {
+    // Everything allocated in the region is released by the reset
+    statistics::report_merge(r.allocations_, r.allocations_, r.allocated_, r.allocated_);
+    if (r.new_chunks_ != 0)
+    {
+      statistics::report_new_arena(r.new_chunks_);
+    }
+    r.allocations_ = 0;
+    r.allocated_   = 0;
+    r.new_chunks_  = 0;
+  }
+
+  std::unique_ptr<worker_data[]> workers_;
+  std::uint32_t                  worker_count_ = 0;
+  std::uint32_t                  region_       = 0;
+  size_type                      chunk_size_   = default_chunk_size;
+  std::uint64_t                  started_      = 0;
+  std::atomic_uint64_t           retired_      = 0;
+};
+
+} // namespace ouly
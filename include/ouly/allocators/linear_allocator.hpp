@@ -147,7 +147,7 @@ public:
     {
       if constexpr (i_alignment)
       {
-        i_size += (std::size_t)i_alignment;
+        i_size += static_cast<std::size_t>(i_alignment);
 
         new_left_over = left_over_ + i_size;
         offset        = (k_arena_size_ - new_left_over);
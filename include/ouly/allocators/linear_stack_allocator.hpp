@@ -67,9 +67,9 @@ public:
 
   ~linear_stack_allocator() noexcept
   {
-    for (auto& arena : arenas_)
+    for (auto& arena_item : arenas_)
     {
-      underlying_allocator::deallocate(arena.buffer_, arena.arena_size_);
+      underlying_allocator::deallocate(arena_item.buffer_, arena_item.arena_size_);
     }
   }
 
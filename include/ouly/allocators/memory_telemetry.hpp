@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ouly
+{
+
+/**
+ * @brief Snapshot of the telemetry of an allocator, for export to a metrics system.
+ *
+ * Histograms are filled when the allocator is configured with cfg::compute_histograms. Bucket i of a histogram counts
+ * the values v with std::bit_width(v) == i, so bucket 0 holds 0 and bucket i > 0 holds [2^(i-1), 2^i). Latencies are
+ * in tsc_clock ticks, ticks_per_us_ converts them to time. Allocators made of arenas also fill arenas_.
+ */
+struct memory_telemetry
+{
+  static constexpr std::uint32_t bucket_count = std::numeric_limits<std::uint64_t>::digits + 1;
+
+  using histogram = std::array<std::uint64_t, bucket_count>;
+
+  struct arena_info
+  {
+    std::uint32_t id_           = 0;
+    std::uint64_t size_         = 0;
+    std::uint64_t free_         = 0;
+    std::uint32_t free_blocks_  = 0;
+    std::uint64_t largest_free_ = 0;
+
+    /**
+     * @brief Share of the free size that cannot serve a request as large as the free size, 0 when it is one block
+     */
+    [[nodiscard]] auto fragmentation() const noexcept -> double
+    {
+      return free_ == 0 ? 0.0 : 1.0 - (static_cast<double>(largest_free_) / static_cast<double>(free_));
+    }
+  };
+
+  histogram               sizes_              = {};
+  histogram               allocation_ticks_   = {};
+  histogram               deallocation_ticks_ = {};
+  double                  ticks_per_us_       = 0.0;
+  std::vector<arena_info> arenas_;
+
+  /**
+   * @brief Upper bound of the bucket holding the p-th quantile of h, p in [0, 1]
+   */
+  [[nodiscard]] static auto percentile(histogram const& h, double p) noexcept -> std::uint64_t
+  {
+    std::uint64_t total = 0;
+    for (auto v : h)
+    {
+      total += v;
+    }
+    if (total == 0)
+    {
+      return 0;
+    }
+
+    auto          rank  = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(p * static_cast<double>(total)));
+    std::uint64_t count = 0;
+    for (std::uint32_t i = 0; i < bucket_count; ++i)
+    {
+      count += h[i];
+      if (count >= rank)
+      {
+        return i == bucket_count - 1 ? std::numeric_limits<std::uint64_t>::max() : (std::uint64_t{1} << i) - 1;
+      }
+    }
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+
+  [[nodiscard]] auto allocation_latency_us(double p) const noexcept -> double
+  {
+    return to_us(percentile(allocation_ticks_, p));
+  }
+
+  [[nodiscard]] auto deallocation_latency_us(double p) const noexcept -> double
+  {
+    return to_us(percentile(deallocation_ticks_, p));
+  }
+
+  /**
+   * @brief Fragmentation of all arenas together, computed from the total free size and the largest free block
+   */
+  [[nodiscard]] auto fragmentation() const noexcept -> double
+  {
+    arena_info all;
+    for (auto const& a : arenas_)
+    {
+      all.free_ += a.free_;
+      all.largest_free_ = std::max(all.largest_free_, a.largest_free_);
+    }
+    return all.fragmentation();
+  }
+
+  [[nodiscard]] auto to_json() const -> std::string
+  {
+    std::stringstream ss;
+    auto              write_histogram = [&ss](char const* name, histogram const& h)
+    {
+      ss << "\"" << name << "\":[";
+      for (std::uint32_t i = 0; i < bucket_count; ++i)
+      {
+        ss << (i != 0 ? "," : "") << h[i];
+      }
+      ss << "],";
+    };
+
+    ss << "{";
+    write_histogram("sizes", sizes_);
+    write_histogram("allocation_ticks", allocation_ticks_);
+    write_histogram("deallocation_ticks", deallocation_ticks_);
+    ss << "\"ticks_per_us\":" << ticks_per_us_ << ",\"allocation_p50_us\":" << allocation_latency_us(0.5)
+       << ",\"allocation_p99_us\":" << allocation_latency_us(0.99)
+       << ",\"deallocation_p50_us\":" << deallocation_latency_us(0.5)
+       << ",\"deallocation_p99_us\":" << deallocation_latency_us(0.99) << ",\"fragmentation\":" << fragmentation()
+       << ",\"arenas\":[";
+    for (std::size_t i = 0; i < arenas_.size(); ++i)
+    {
+      auto const& a = arenas_[i];
+      ss << (i != 0 ? "," : "") << "{\"id\":" << a.id_ << ",\"size\":" << a.size_ << ",\"free\":" << a.free_
+         << ",\"free_blocks\":" << a.free_blocks_ << ",\"largest_free\":" << a.largest_free_
+         << ",\"fragmentation\":" << a.fragmentation() << "}";
+    }
+    ss << "]}";
+    return ss.str();
+  }
+
+private:
+  [[nodiscard]] auto to_us(std::uint64_t ticks) const noexcept -> double
+  {
+    return ticks_per_us_ > 0.0 ? static_cast<double>(ticks) / ticks_per_us_ : 0.0;
+  }
+};
+
+} // namespace ouly
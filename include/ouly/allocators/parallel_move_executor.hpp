@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ouly/scheduler/parallel_for.hpp"
+#include <span>
+
+namespace ouly
+{
+
+/**
+ * @brief Move executor for arena_allocator::defragment and defragment_step that copies the memory with parallel_for.
+ *
+ * Every batch of independent moves handed by the allocator is spread over the workers of the context's workgroup, one
+ * move per task, and the call returns once the batch is done. Large moves are already split in chunks by the
+ * allocator, so a single big compaction also keeps several workers busy. The manager's move_memory is called
+ * concurrently for disjoint ranges.
+ *
+ * Usage:
+ * @code
+ *   allocator.defragment(ouly::parallel_move_executor(ctx));
+ *   while (!allocator.defragment_step(budget, ouly::parallel_move_executor(ctx)))
+ *     ;
+ * @endcode
+ */
+class parallel_move_executor
+{
+public:
+  explicit parallel_move_executor(worker_context const& ctx) noexcept : ctx_(&ctx) {}
+
+  template <typename Move, typename Fn>
+  void operator()(std::span<Move const> batch, Fn const& move) const
+  {
+    ouly::parallel_for(
+     [&move](Move const& m, [[maybe_unused]] worker_context const& wc)
+     {
+       move(m);
+     },
+     batch, *ctx_, task_traits{});
+  }
+
+private:
+  struct task_traits : default_task_traits
+  {
+    // Every move is worth a task, a batch often holds only a few large ones
+    static constexpr uint32_t parallel_execution_threshold = 1;
+  };
+
+  worker_context const* ctx_ = nullptr;
+};
+
+} // namespace ouly
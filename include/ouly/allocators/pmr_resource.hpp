@@ -0,0 +1,223 @@
+#pragma once
+
+#include "ouly/allocators/default_allocator.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+namespace ouly
+{
+
+struct pmr_upstream_allocator_tag
+{};
+
+/**
+ * @brief A std::pmr::memory_resource that forwards to an ouly allocator, so pmr containers can use ouly arenas.
+ *
+ * Works with any allocator taking a compile time alignment, such as @ref linear_arena_allocator,
+ * @ref linear_stack_allocator, @ref pool_allocator and @ref default_allocator. With a value type the resource owns
+ * the allocator, constructed from the resource's arguments. With a reference type, pmr_resource<Alloc&>, it refers to
+ * an allocator owned elsewhere. The class is final and calls the allocator directly, so the only indirection left is
+ * the virtual call of memory_resource itself.
+ *
+ * Sizes are rounded up to a multiple of alignof(void*), which keeps the bump pointer of linear allocators aligned for
+ * the requests that need no more than that. Larger alignments, up to max_alignment, are passed to the allocator as
+ * alignment<N>. Larger ones throw std::bad_alloc.
+ *
+ * @code
+ * ouly::linear_arena_allocator<>                      arena;
+ * ouly::pmr_resource<ouly::linear_arena_allocator<>&> resource(arena);
+ * std::pmr::vector<int>                               values(&resource);
+ * @endcode
+ */
+template <typename Alloc>
+class pmr_resource final : public std::pmr::memory_resource
+{
+public:
+  using allocator_type = std::remove_reference_t<Alloc>;
+  using size_type      = typename allocator_type::size_type;
+
+  static constexpr std::size_t natural_alignment = alignof(void*);
+  static constexpr std::size_t max_alignment     = 4096;
+
+  template <typename... Args>
+  explicit pmr_resource(Args&&... args) : impl_(std::forward<Args>(args)...)
+  {}
+
+  pmr_resource(pmr_resource const&)                    = delete;
+  pmr_resource(pmr_resource&&)                         = delete;
+  ~pmr_resource() noexcept override                    = default;
+  auto operator=(pmr_resource const&) -> pmr_resource& = delete;
+  auto operator=(pmr_resource&&) -> pmr_resource&      = delete;
+
+  [[nodiscard]] auto get_allocator() noexcept -> allocator_type&
+  {
+    return impl_;
+  }
+
+  [[nodiscard]] auto get_allocator() const noexcept -> allocator_type const&
+  {
+    return impl_;
+  }
+
+private:
+  auto do_allocate(std::size_t bytes, std::size_t align) -> void* override
+  {
+    auto size = rounded(bytes);
+    return dispatch(align,
+                    [this, size](auto a) -> void*
+                    {
+                      return impl_.allocate(size, a);
+                    });
+  }
+
+  void do_deallocate(void* ptr, std::size_t bytes, std::size_t align) override
+  {
+    auto size = rounded(bytes);
+    dispatch(align,
+             [this, ptr, size](auto a)
+             {
+               impl_.deallocate(ptr, size, a);
+             });
+  }
+
+  [[nodiscard]] auto do_is_equal(std::pmr::memory_resource const& other) const noexcept -> bool override
+  {
+    if (this == &other)
+    {
+      return true;
+    }
+    // Stateless allocators can free what any other instance allocated
+    if constexpr (allocator_traits<typename allocator_type::tag>::is_always_equal::value)
+    {
+      return dynamic_cast<pmr_resource const*>(&other) != nullptr;
+    }
+    return false;
+  }
+
+  static auto rounded(std::size_t bytes) noexcept -> size_type
+  {
+    return static_cast<size_type>((bytes + natural_alignment - 1) & ~(natural_alignment - 1));
+  }
+
+  /**
+   * @brief Calls fn with the alignment<N> matching a run time alignment
+   */
+  template <typename Fn>
+  static auto dispatch(std::size_t align, Fn&& fn)
+  {
+    switch (align)
+    {
+    case 16:
+      return fn(alignment<16>());
+    case 32:
+      return fn(alignment<32>());
+    case 64:
+      return fn(alignment<64>());
+    case 128:
+      return fn(alignment<128>());
+    case 256:
+      return fn(alignment<256>());
+    case 512:
+      return fn(alignment<512>());
+    case 1024:
+      return fn(alignment<1024>());
+    case 2048:
+      return fn(alignment<2048>());
+    case max_alignment:
+      return fn(alignment<max_alignment>());
+    default:
+      if (align > natural_alignment)
+      {
+        throw std::bad_alloc();
+      }
+      return fn(alignment<>());
+    }
+  }
+
+  Alloc impl_;
+};
+
+/**
+ * @brief Underlying allocator that takes its memory from a std::pmr::memory_resource.
+ *
+ * Meant as the cfg::underlying_allocator of ouly allocators that should draw their arenas from an upstream resource,
+ * for example a std::pmr::monotonic_buffer_resource over a fixed buffer. Underlying allocators are called statically,
+ * so the resource is set per Tag with set_resource(), and std::pmr::get_default_resource() is used until then. Blocks
+ * are at least alignof(std::max_align_t) aligned.
+ *
+ * @code
+ * struct level_memory {};
+ * using level_upstream = ouly::pmr_upstream_allocator<level_memory>;
+ * level_upstream::set_resource(&level_resource);
+ * ouly::linear_arena_allocator<ouly::config<ouly::cfg::underlying_allocator<level_upstream>>> arena;
+ * @endcode
+ *
+ * @note set_resource() must not be called while memory allocated from the previous resource is still in use.
+ */
+template <typename Tag = void>
+struct pmr_upstream_allocator
+{
+  using tag       = pmr_upstream_allocator_tag;
+  using address   = void*;
+  using size_type = std::size_t;
+
+  static void set_resource(std::pmr::memory_resource* resource) noexcept
+  {
+    resource_ = resource;
+  }
+
+  [[nodiscard]] static auto get_resource() noexcept -> std::pmr::memory_resource*
+  {
+    return resource_ != nullptr ? resource_ : std::pmr::get_default_resource();
+  }
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] static auto allocate(size_type size, Alignment align = {}) -> address
+  {
+    return get_resource()->allocate(size, block_alignment(align));
+  }
+
+  template <typename Alignment = alignment<>>
+  static void deallocate(address addr, size_type size, Alignment align = {})
+  {
+    get_resource()->deallocate(addr, size, block_alignment(align));
+  }
+
+  static constexpr auto null() -> void*
+  {
+    return nullptr;
+  }
+
+  constexpr auto operator==(pmr_upstream_allocator const& /*unused*/) const -> bool
+  {
+    return true;
+  }
+
+  constexpr auto operator!=(pmr_upstream_allocator const& /*unused*/) const -> bool
+  {
+    return false;
+  }
+
+private:
+  static constexpr auto block_alignment(std::size_t align) noexcept -> std::size_t
+  {
+    return std::max(align, alignof(std::max_align_t));
+  }
+
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+  static inline std::pmr::memory_resource* resource_ = nullptr;
+};
+
+template <>
+struct allocator_traits<pmr_upstream_allocator_tag>
+{
+  using is_always_equal                        = std::true_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_swap            = std::false_type;
+};
+
+} // namespace ouly
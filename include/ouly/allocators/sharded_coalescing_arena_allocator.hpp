@@ -0,0 +1,285 @@
+#pragma once
+
+#include "ouly/allocators/coalescing_arena_allocator.hpp"
+#include "ouly/utility/config.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace ouly
+{
+
+namespace detail
+{
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+inline std::atomic_uint32_t ca_shard_counter = 0;
+} // namespace detail
+
+/**
+ * @brief A thread safe @ref coalescing_arena_allocator split in shards, each owning its own arenas behind its own lock.
+ *
+ * A thread is assigned a home shard the first time it allocates, and threads are spread round robin over the shards.
+ * An allocation first looks at the home shard, then steals from the other shards that have a large enough free block
+ * and are not locked at the moment, and only adds an arena to the home shard when neither worked. Requests that would
+ * get a dedicated arena go to the home shard directly. Frees lock only the shard that owns the arena.
+ *
+ * Handles keep the ca_allocation format. The shard is encoded in the low part of the ids, an arena_id or an
+ * allocation_id is its shard local id times the shard count plus the shard index, so both stay unique across the
+ * allocator and can still be used as indexes. A shard can therefore own at most 65534 / shard_count arenas, an
+ * allocation that would need more, or more blocks than the allocation_id range can encode, fails and returns a
+ * ca_allocation with an allocation_id() id.
+ *
+ * @note The manager is called from the thread that adds or drops an arena, under the lock of that shard only, so
+ * different shards call it concurrently and its add() and remove() must be thread safe.
+ */
+class sharded_coalescing_arena_allocator
+{
+public:
+  using size_type = allocation_size_type;
+
+  explicit sharded_coalescing_arena_allocator(uint32_t shard_count = std::max(1U, std::thread::hardware_concurrency()),
+                                              size_type arena_size  = 0)
+      : shards_(std::make_unique<shard_data[]>(shard_count)), shard_count_(shard_count)
+  {
+    assert(shard_count > 0 && shard_count < std::numeric_limits<uint16_t>::max());
+    set_arena_size(arena_size);
+  }
+
+  sharded_coalescing_arena_allocator(sharded_coalescing_arena_allocator const&)                    = delete;
+  sharded_coalescing_arena_allocator(sharded_coalescing_arena_allocator&&)                         = delete;
+  auto operator=(sharded_coalescing_arena_allocator const&) -> sharded_coalescing_arena_allocator& = delete;
+  auto operator=(sharded_coalescing_arena_allocator&&) -> sharded_coalescing_arena_allocator&      = delete;
+  ~sharded_coalescing_arena_allocator() noexcept                                                   = default;
+
+  /** @brief Arena size of all shards, it can only increase. Must not be called concurrently with allocations. */
+  void set_arena_size(size_type s) noexcept
+  {
+    for (uint32_t i = 0; i < shard_count_; ++i)
+    {
+      shards_[i].allocator_.set_arena_size(s);
+    }
+    arena_size_ = shards_[0].allocator_.get_arena_size();
+  }
+
+  [[nodiscard]] auto get_arena_size() const noexcept -> size_type
+  {
+    return arena_size_;
+  }
+
+  [[nodiscard]] auto get_shard_count() const noexcept -> uint32_t
+  {
+    return shard_count_;
+  }
+
+  /** @brief Home shard of the calling thread */
+  [[nodiscard]] auto get_local_shard() const noexcept -> uint32_t
+  {
+    thread_local uint32_t seed = ouly::detail::ca_shard_counter.fetch_add(1, std::memory_order_relaxed);
+    return seed % shard_count_;
+  }
+
+  /** @brief Shard owning an arena */
+  [[nodiscard]] auto get_shard(arena_id arena) const noexcept -> uint32_t
+  {
+    return arena.get() % shard_count_;
+  }
+
+  /** @brief Shard owning an allocation */
+  [[nodiscard]] auto get_shard(allocation_id id) const noexcept -> uint32_t
+  {
+    return id.get() % shard_count_;
+  }
+
+  template <CoalescingMemoryManager M, typename Alignment = ouly::alignment<>, typename Dedicated = std::false_type>
+  auto allocate(size_type size, M& manager, Alignment alignment = {}, Dedicated dedicated = {}) -> ca_allocation
+  {
+    auto const home  = get_local_shard();
+    auto const vsize = alignment ? size + static_cast<size_type>(alignment) : size;
+
+    if (!Dedicated::value && vsize < arena_size_)
+    {
+      for (uint32_t i = 0; i < shard_count_; ++i)
+      {
+        auto  index = (home + i) % shard_count_;
+        auto& s     = shards_[index];
+        if (s.max_free_.load(std::memory_order_relaxed) < size)
+        {
+          continue;
+        }
+
+        // The home shard is waited for, the others are only taken when free
+        auto lock = i == 0 ? std::unique_lock(s.lock_) : std::unique_lock(s.lock_, std::try_to_lock);
+        if (!lock.owns_lock() || !has_ids(s, index, false))
+        {
+          continue;
+        }
+        auto al = s.allocator_.try_allocate(size);
+        s.update_max_free();
+        if (al.get_allocation_id() != allocation_id())
+        {
+          return to_global(al, index);
+        }
+      }
+    }
+
+    auto& s    = shards_[home];
+    auto  lock = std::scoped_lock(s.lock_);
+    if (!has_ids(s, home, true))
+    {
+      return {};
+    }
+    auto mgr = shard_manager<M>{.manager_ = &manager, .shard_ = &s, .index_ = home, .shard_count_ = shard_count_};
+    auto al  = s.allocator_.allocate(size, mgr, alignment, dedicated);
+    s.update_max_free();
+    return to_global(al, home);
+  }
+
+  /** @brief Deallocate an allocation, the shard is found from its arena. */
+  template <CoalescingMemoryManager M>
+  void deallocate(ca_allocation const& allocation, M& manager)
+  {
+    deallocate(get_shard(allocation.get_arena_id()), allocation.get_allocation_id(), manager);
+  }
+
+  template <CoalescingMemoryManager M>
+  void deallocate(allocation_id id, M& manager)
+  {
+    deallocate(get_shard(id), id, manager);
+  }
+
+  [[nodiscard]] auto get_size(allocation_id id) const -> size_type
+  {
+    auto& s    = shards_[get_shard(id)];
+    auto  lock = std::scoped_lock(s.lock_);
+    return s.allocator_.get_size(to_local(id));
+  }
+
+  [[nodiscard]] auto get_offset(allocation_id id) const -> size_type
+  {
+    auto& s    = shards_[get_shard(id)];
+    auto  lock = std::scoped_lock(s.lock_);
+    return s.allocator_.get_offset(to_local(id));
+  }
+
+  [[nodiscard]] auto get_arena(allocation_id id) const -> arena_id
+  {
+    auto  index = get_shard(id);
+    auto& s     = shards_[index];
+    auto  lock  = std::scoped_lock(s.lock_);
+    return to_global(s.allocator_.get_arena(to_local(id)), index);
+  }
+
+  void validate_integrity() const
+  {
+    for (uint32_t i = 0; i < shard_count_; ++i)
+    {
+      auto lock = std::scoped_lock(shards_[i].lock_);
+      shards_[i].allocator_.validate_integrity();
+    }
+  }
+
+private:
+  struct alignas(ouly::detail::cache_line_size) shard_data
+  {
+    std::mutex                 lock_;
+    coalescing_arena_allocator allocator_;
+    // Largest free block, read without the lock to skip shards that cannot serve a request
+    std::atomic<size_type>     max_free_    = 0;
+    uint32_t                   arena_count_ = 0;
+
+    void update_max_free() noexcept
+    {
+      max_free_.store(allocator_.get_max_free_size(), std::memory_order_relaxed);
+    }
+  };
+
+  /**
+   * @brief Passes the arenas of a shard to the user's manager with their global ids
+   */
+  template <typename M>
+  struct shard_manager
+  {
+    M*          manager_     = nullptr;
+    shard_data* shard_       = nullptr;
+    uint32_t    index_       = 0;
+    uint32_t    shard_count_ = 1;
+
+    void add(arena_id arena, size_type size)
+    {
+      assert((uint32_t{arena.get()} * shard_count_) + index_ < std::numeric_limits<uint16_t>::max());
+      shard_->arena_count_++;
+      manager_->add(to_global(arena, index_, shard_count_), size);
+    }
+
+    void remove(arena_id arena)
+    {
+      shard_->arena_count_--;
+      manager_->remove(to_global(arena, index_, shard_count_));
+    }
+  };
+
+  /**
+   * @brief Checks that the ids an allocation can create in a shard still have a global id
+   *
+   * An allocation adds at most two blocks, the block of a new arena and the remainder of a split, which get local ids
+   * up to the current block count plus one. Arena ids are reused and start at 1, so while all of them fit, a new arena
+   * gets a local id no larger than the arena count after adding it.
+   */
+  [[nodiscard]] auto has_ids(shard_data const& s, uint32_t index, bool new_arena) const noexcept -> bool
+  {
+    auto last_block = uint64_t{s.allocator_.get_sizes().size()} + 1;
+    if ((last_block * shard_count_) + index >= std::numeric_limits<uint32_t>::max())
+    {
+      return false;
+    }
+    auto last_arena = uint64_t{s.arena_count_} + 1;
+    return !new_arena || (last_arena * shard_count_) + index < std::numeric_limits<uint16_t>::max();
+  }
+
+  template <CoalescingMemoryManager M>
+  void deallocate(uint32_t index, allocation_id id, M& manager)
+  {
+    auto& s    = shards_[index];
+    auto  lock = std::scoped_lock(s.lock_);
+    auto  mgr  = shard_manager<M>{.manager_ = &manager, .shard_ = &s, .index_ = index, .shard_count_ = shard_count_};
+    s.allocator_.deallocate(to_local(id), mgr);
+    s.update_max_free();
+  }
+
+  static auto to_global(arena_id arena, uint32_t shard, uint32_t count) noexcept -> arena_id
+  {
+    return arena_id{.id_ = static_cast<uint16_t>((arena.get() * count) + shard)};
+  }
+
+  [[nodiscard]] auto to_global(arena_id arena, uint32_t shard) const noexcept -> arena_id
+  {
+    return to_global(arena, shard, shard_count_);
+  }
+
+  [[nodiscard]] auto to_global(ca_allocation al, uint32_t shard) const noexcept -> ca_allocation
+  {
+    if (al.get_allocation_id() == allocation_id())
+    {
+      return al;
+    }
+    al.id_    = allocation_id{.id_ = (al.id_.get() * shard_count_) + shard};
+    al.arena_ = to_global(al.arena_, shard);
+    return al;
+  }
+
+  [[nodiscard]] auto to_local(allocation_id id) const noexcept -> allocation_id
+  {
+    return allocation_id{.id_ = id.get() / shard_count_};
+  }
+
+  std::unique_ptr<shard_data[]> shards_;
+  uint32_t                      shard_count_ = 1;
+  size_type                     arena_size_  = 0;
+};
+
+} // namespace ouly
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "ouly/allocators/pool_allocator.hpp"
+#include "ouly/utility/config.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+namespace ouly
+{
+
+struct small_object_allocator_tag
+{};
+
+struct shared_small_object_allocator_tag
+{};
+
+/**
+ * @brief General purpose allocator for small objects, made of one @ref pool_allocator bucket per size class.
+ *
+ * Size classes are 16 bytes apart up to 128 bytes, then every power of two range is split in 8 classes, which keeps the
+ * waste per allocation under 12.5%. Requests up to max_size bytes are rounded up to their class and served from the
+ * class bucket as a single atom, larger requests and alignments above alignof(std::max_align_t) go to the underlying
+ * allocator. Each bucket grows by arenas of about bucket_arena_size bytes.
+ *
+ * The allocator is not thread safe. To use it as the allocator of containers, see @ref shared_small_object_allocator.
+ *
+ * Options:
+ * - cfg::underlying_allocator: allocator for bucket arenas and large requests
+ * - cfg::compute_stats, cfg::compute_atomic_stats: statistics
+ */
+template <typename Config = ouly::config<>>
+class small_object_allocator : ouly::detail::statistics<small_object_allocator_tag, Config>
+{
+public:
+  using tag                                      = small_object_allocator_tag;
+  using statistics                               = ouly::detail::statistics<small_object_allocator_tag, Config>;
+  using underlying_allocator                     = ouly::detail::underlying_allocator_t<Config>;
+  using size_type                                = typename underlying_allocator::size_type;
+  using address                                  = typename underlying_allocator::address;
+  static constexpr std::size_t min_size          = 16;
+  static constexpr std::size_t max_size          = 1024;
+  static constexpr std::size_t class_count       = 32;
+  static constexpr std::size_t bucket_arena_size = 16384;
+
+  small_object_allocator() noexcept : buckets_(make_buckets(std::make_index_sequence<class_count>())) {}
+
+  small_object_allocator(small_object_allocator const&)                        = delete;
+  small_object_allocator(small_object_allocator&&) noexcept                    = default;
+  auto operator=(small_object_allocator const&) -> small_object_allocator&     = delete;
+  auto operator=(small_object_allocator&&) noexcept -> small_object_allocator& = default;
+  ~small_object_allocator() noexcept                                           = default;
+
+  constexpr static auto null() -> address
+  {
+    return underlying_allocator::null();
+  }
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] auto allocate(size_type size_value, Alignment alignment = {}) -> address
+  {
+    [[maybe_unused]] auto measure = statistics::report_allocate(size_value);
+    auto                  index   = size_class(size_value, static_cast<std::size_t>(alignment));
+    if (index == class_count)
+    {
+      return underlying_allocator::allocate(size_value, alignment);
+    }
+    return buckets_[index].allocate(static_cast<size_type>(class_size(index)));
+  }
+
+  template <typename Alignment = alignment<>>
+  void deallocate(address i_ptr, size_type size_value, Alignment alignment = {})
+  {
+    [[maybe_unused]] auto measure = statistics::report_deallocate(size_value);
+    auto                  index   = size_class(size_value, static_cast<std::size_t>(alignment));
+    if (index == class_count)
+    {
+      underlying_allocator::deallocate(i_ptr, size_value, alignment);
+      return;
+    }
+    buckets_[index].deallocate(i_ptr, static_cast<size_type>(class_size(index)));
+  }
+
+  /**
+   * @brief Returns the size class serving the request, or class_count if it goes to the underlying allocator
+   */
+  [[nodiscard]] static constexpr auto size_class(std::size_t size_value, std::size_t alignment_value = 0) noexcept
+   -> std::size_t
+  {
+    if (size_value > max_size || alignment_value > alignof(std::max_align_t))
+    {
+      return class_count;
+    }
+    if (size_value <= 128)
+    {
+      return size_value == 0 ? 0 : (size_value - 1) / min_size;
+    }
+    // 8 classes per power of two range, range [2^p, 2^(p+1)) starting at p = 7
+    auto const last  = size_value - 1;
+    auto const range = static_cast<std::size_t>(std::bit_width(last)) - 1;
+    return 8 + ((range - 7) * 8) + ((last >> (range - 3)) - 8);
+  }
+
+  /**
+   * @brief Size of the blocks handed out by the size class
+   */
+  [[nodiscard]] static constexpr auto class_size(std::size_t index) noexcept -> std::size_t
+  {
+    if (index < 8)
+    {
+      return (index + 1) * min_size;
+    }
+    auto const range = 7 + ((index - 8) / 8);
+    auto const step  = std::size_t{1} << (range - 3);
+    return (std::size_t{1} << range) + ((((index - 8) % 8) + 1) * step);
+  }
+
+  using statistics::print;
+
+private:
+  using bucket_type = pool_allocator<ouly::config<cfg::underlying_allocator<underlying_allocator>>>;
+
+  template <std::size_t... I>
+  static auto make_buckets(std::index_sequence<I...> /*unused*/) noexcept -> std::array<bucket_type, class_count>
+  {
+    return {bucket_type(static_cast<size_type>(class_size(I)),
+                        static_cast<size_type>(std::max<std::size_t>(bucket_arena_size / class_size(I), 8)))...};
+  }
+
+  std::array<bucket_type, class_count> buckets_;
+};
+
+/**
+ * @brief Stateless, thread safe front end for a process wide @ref small_object_allocator, for use in containers.
+ *
+ * Every instance refers to the same allocator, one per Config, so instances compare equal and can be copied into
+ * containers freely. Each size class is guarded by its own mutex, large requests go to the underlying allocator without
+ * a lock.
+ *
+ * @code
+ * using allocator = ouly::shared_small_object_allocator<>;
+ * ouly::vector<int, allocator> v;
+ * ouly::small_vector<int, 4, ouly::config<ouly::cfg::allocator_type<allocator>>> sv;
+ * @endcode
+ *
+ * @note The shared allocator is never destroyed, so containers with static storage duration can release memory to it
+ * during program exit. Statistics, if enabled, must be cfg::compute_atomic_stats.
+ */
+template <typename Config = ouly::config<>>
+struct shared_small_object_allocator
+{
+  using tag            = shared_small_object_allocator_tag;
+  using allocator_type = small_object_allocator<Config>;
+  using size_type      = typename allocator_type::size_type;
+  using address        = typename allocator_type::address;
+
+  static_assert(ouly::detail::stats_impl<Config>::option != ouly::cfg::memory_stat_type::e_compute,
+                "shared_small_object_allocator needs thread safe statistics, use cfg::compute_atomic_stats");
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] static auto allocate(size_type size_value, Alignment alignment = {}) -> address
+  {
+    auto& s     = state();
+    auto  index = allocator_type::size_class(size_value, static_cast<std::size_t>(alignment));
+    if (index == allocator_type::class_count)
+    {
+      return s.allocator_.allocate(size_value, alignment);
+    }
+    auto lck = std::scoped_lock(s.locks_[index].lock_);
+    return s.allocator_.allocate(size_value, alignment);
+  }
+
+  template <typename Alignment = alignment<>>
+  static void deallocate(address i_ptr, size_type size_value, Alignment alignment = {})
+  {
+    auto& s     = state();
+    auto  index = allocator_type::size_class(size_value, static_cast<std::size_t>(alignment));
+    if (index == allocator_type::class_count)
+    {
+      s.allocator_.deallocate(i_ptr, size_value, alignment);
+      return;
+    }
+    auto lck = std::scoped_lock(s.locks_[index].lock_);
+    s.allocator_.deallocate(i_ptr, size_value, alignment);
+  }
+
+  static constexpr auto null() -> address
+  {
+    return allocator_type::null();
+  }
+
+  constexpr auto operator==(shared_small_object_allocator const& /*unused*/) const -> bool
+  {
+    return true;
+  }
+
+  constexpr auto operator!=(shared_small_object_allocator const& /*unused*/) const -> bool
+  {
+    return false;
+  }
+
+private:
+  struct bucket_lock
+  {
+    alignas(ouly::detail::cache_line_size) std::mutex lock_;
+  };
+
+  struct shared_state
+  {
+    allocator_type                                       allocator_;
+    std::array<bucket_lock, allocator_type::class_count> locks_;
+  };
+
+  static auto state() -> shared_state&
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    static auto* instance = new shared_state();
+    return *instance;
+  }
+};
+
+template <>
+struct allocator_traits<shared_small_object_allocator_tag>
+{
+  using is_always_equal                        = std::true_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_swap            = std::false_type;
+};
+
+} // namespace ouly
@@ -2,6 +2,7 @@
 
 #include "ouly/allocators/config.hpp"
 #include "ouly/allocators/detail/arena.hpp"
+#include "ouly/allocators/detail/simd_search.hpp"
 #include "ouly/allocators/detail/strat_concepts.hpp"
 #include "ouly/utility/type_traits.hpp"
 #include <optional>
@@ -264,6 +265,10 @@ protected:
     {
       return mini2(it, s, key);
     }
+    else if constexpr (bsearch_algo == 3)
+    {
+      return ouly::detail::simd_lower_bound(it, s, key);
+    }
   }
 
   static auto find_free_it(size_type const* it, size_t s, size_type key) noexcept
@@ -0,0 +1,297 @@
+#pragma once
+
+#include "ouly/allocators/config.hpp"
+#include "ouly/allocators/detail/arena.hpp"
+#include "ouly/allocators/strat/best_fit_v2.hpp"
+#include <algorithm>
+#include <array>
+#include <type_traits>
+
+namespace ouly::strat
+{
+
+/**
+ * @brief Strategy class for arena_allocator that keeps small free blocks in direct indexed slots.
+ *
+ * A free block of size s below granularity * max_bucket is kept in the list of slot s / granularity, every other block
+ * is handed to the fallback strategy. A request looks at the first non empty slot among the search_window slots
+ * starting at its rounded up slot, so repeated small sizes are served in constant time, then at the blocks of its own
+ * slot, then at the fallback strategy, and finally at the remaining slots.
+ *
+ * Options:
+ * - cfg::granularity: size covered by a slot, default 256
+ * - cfg::max_bucket: number of slots, default 255
+ * - cfg::search_window: slots looked at before the fallback, default 4
+ * - cfg::fallback_start: strategy for the larger blocks, default best_fit_v2
+ */
+template <typename Config = ouly::config<>>
+class slotted_v0
+{
+public:
+  using fallback_strat  = ouly::detail::fallback_strat_t<Config, best_fit_v2<Config>>;
+  using fallback_result = typename fallback_strat::allocate_result;
+  using extension       = typename fallback_strat::extension;
+  using size_type       = ouly::detail::choose_size_t<uint32_t, Config>;
+  using arena_bank      = ouly::detail::arena_bank<size_type, extension>;
+  using block_bank      = ouly::detail::block_bank<size_type, extension>;
+  using block           = ouly::detail::block<size_type, extension>;
+  using bank_data       = ouly::detail::bank_data<size_type, extension>;
+  using block_link      = typename block_bank::link;
+
+  static_assert(std::is_same_v<typename fallback_strat::size_type, size_type>,
+                "Fallback strategy must use the same size type");
+
+  static constexpr size_type min_granularity = 4;
+  static constexpr size_type granularity     = static_cast<size_type>(ouly::detail::granularity_v<Config>);
+  static constexpr uint32_t  max_bucket      = static_cast<uint32_t>(ouly::detail::max_bucket_v<Config>);
+  static constexpr uint32_t  search_window   = static_cast<uint32_t>(ouly::detail::search_window_v<Config>);
+  static constexpr size_type slot_limit      = granularity * max_bucket;
+
+  struct allocate_result
+  {
+    std::uint32_t   block_    = 0;
+    fallback_result fallback_ = {};
+
+    explicit operator bool() const noexcept
+    {
+      return block_ != 0 || static_cast<bool>(fallback_);
+    }
+  };
+
+  slotted_v0() noexcept             = default;
+  slotted_v0(slotted_v0 const&)     = default;
+  slotted_v0(slotted_v0&&) noexcept = default;
+  ~slotted_v0() noexcept            = default;
+
+  auto operator=(slotted_v0 const&) -> slotted_v0&     = default;
+  auto operator=(slotted_v0&&) noexcept -> slotted_v0& = default;
+
+  [[nodiscard]] auto try_allocate(bank_data& bank, size_type size) -> allocate_result
+  {
+    if (size >= slot_limit)
+    {
+      return {0, fallback_.try_allocate(bank, size)};
+    }
+
+    // Any block in a slot at or above the rounded up size fits
+    auto first = static_cast<uint32_t>((size + granularity - 1) / granularity);
+    auto last  = std::min(first + search_window, max_bucket);
+    for (auto slot = first; slot < last; ++slot)
+    {
+      if (heads_[slot] != 0U)
+      {
+        return {heads_[slot]};
+      }
+    }
+
+    for (uint32_t i = heads_[size / granularity]; i != 0U;)
+    {
+      auto const& blk = bank.blocks_[block_link(i)];
+      if (blk.size_ >= size)
+      {
+        return {i};
+      }
+      i = blk.list_.next_;
+    }
+
+    if (auto found = fallback_.try_allocate(bank, size))
+    {
+      return {0, found};
+    }
+
+    for (auto slot = last; slot < max_bucket; ++slot)
+    {
+      if (heads_[slot] != 0U)
+      {
+        return {heads_[slot]};
+      }
+    }
+    return {};
+  }
+
+  auto commit(bank_data& bank, size_type size, allocate_result found) -> std::uint32_t
+  {
+    if (found.block_ == 0)
+    {
+      auto id = fallback_.commit(bank, size, found.fallback_);
+      reclaim_remainder(bank.blocks_, id);
+      return id;
+    }
+
+    erase(bank.blocks_, found.block_);
+
+    auto& blk = bank.blocks_[block_link(found.block_)];
+    // Marker
+    blk.is_free_ = false;
+
+    auto remaining = blk.size_ - size;
+    blk.size_      = size;
+    if (remaining > 0)
+    {
+      auto& list  = bank.arenas_[blk.arena_].block_order();
+      auto  arena = blk.arena_;
+
+      auto newblk = bank.blocks_.emplace(blk.offset_ + size, remaining, arena, ouly::detail::list_node(), true);
+      list.insert_after(bank.blocks_, found.block_, (uint32_t)newblk);
+      add_free(bank.blocks_, (uint32_t)newblk);
+    }
+    return found.block_;
+  }
+
+  void add_free_arena(block_bank& blocks, std::uint32_t block)
+  {
+    if (blocks[block_link(block)].size_ >= slot_limit)
+    {
+      fallback_.add_free_arena(blocks, block);
+    }
+    else
+    {
+      add_free(blocks, block);
+    }
+  }
+
+  void add_free(block_bank& blocks, std::uint32_t block)
+  {
+    auto& blk = blocks[block_link(block)];
+    if (blk.size_ >= slot_limit)
+    {
+      // The block may come out of a slot, clear what the slot left in the fallback's links
+      blk.ext_ = extension();
+      fallback_.add_free(blocks, block);
+      return;
+    }
+
+    auto& head      = heads_[blk.size_ / granularity];
+    blk.is_slotted_ = true;
+    blk.list_.prev_ = 0;
+    blk.list_.next_ = head;
+    if (head != 0U)
+    {
+      blocks[block_link(head)].list_.prev_ = block;
+    }
+    head = block;
+  }
+
+  void grow_free_node(block_bank& blocks, std::uint32_t block, size_type newsize)
+  {
+    if (!blocks[block_link(block)].is_slotted_)
+    {
+      fallback_.grow_free_node(blocks, block, newsize);
+      return;
+    }
+    erase(blocks, block);
+    blocks[block_link(block)].size_ = newsize;
+    add_free(blocks, block);
+  }
+
+  void replace_and_grow(block_bank& blocks, std::uint32_t block, std::uint32_t new_block, size_type new_size)
+  {
+    if (!blocks[block_link(block)].is_slotted_)
+    {
+      blocks[block_link(new_block)].ext_ = extension();
+      fallback_.replace_and_grow(blocks, block, new_block, new_size);
+      return;
+    }
+    erase(blocks, block);
+    blocks[block_link(new_block)].size_ = new_size;
+    add_free(blocks, new_block);
+  }
+
+  void erase(block_bank& blocks, std::uint32_t node)
+  {
+    auto& blk = blocks[block_link(node)];
+    if (!blk.is_slotted_)
+    {
+      fallback_.erase(blocks, node);
+      return;
+    }
+
+    if (blk.list_.next_)
+    {
+      blocks[block_link(blk.list_.next_)].list_.prev_ = blk.list_.prev_;
+    }
+    if (blk.list_.prev_)
+    {
+      blocks[block_link(blk.list_.prev_)].list_.next_ = blk.list_.next_;
+    }
+    else
+    {
+      heads_[blk.size_ / granularity] = blk.list_.next_;
+    }
+    blk.list_       = {};
+    blk.is_slotted_ = false;
+  }
+
+  auto total_free_nodes(block_bank const& blocks) const -> std::uint32_t
+  {
+    uint32_t count = fallback_.total_free_nodes(blocks);
+    for (auto head : heads_)
+    {
+      for (uint32_t i = head; i != 0U; i = blocks[block_link(i)].list_.next_)
+      {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  auto total_free_size(block_bank const& blocks) const -> size_type
+  {
+    size_type sz = fallback_.total_free_size(blocks);
+    for (auto head : heads_)
+    {
+      for (uint32_t i = head; i != 0U; i = blocks[block_link(i)].list_.next_)
+      {
+        sz += blocks[block_link(i)].size_;
+      }
+    }
+    return sz;
+  }
+
+  void validate_integrity(block_bank const& blocks) const
+  {
+    for (uint32_t slot = 0; slot < max_bucket; ++slot)
+    {
+      uint32_t p = 0;
+      for (uint32_t i = heads_[slot]; i != 0U; i = blocks[block_link(i)].list_.next_)
+      {
+        auto const& blk = blocks[block_link(i)];
+        assert(blk.is_free_ && blk.is_slotted_);
+        assert(blk.size_ / granularity == slot);
+        assert(blk.list_.prev_ == p);
+        p = i;
+      }
+    }
+    fallback_.validate_integrity(blocks);
+  }
+
+  template <typename Owner>
+  void init(Owner const& owner)
+  {
+    fallback_.init(owner);
+  }
+
+private:
+  /**
+   * @brief Moves the part left over by a fallback allocation into the slots if it is small enough
+   */
+  void reclaim_remainder(block_bank& blocks, std::uint32_t id)
+  {
+    auto next = blocks[block_link(id)].arena_order_.next_;
+    if (next == 0U)
+    {
+      return;
+    }
+    auto const& blk = blocks[block_link(next)];
+    if (blk.is_free_ && !blk.is_slotted_ && blk.size_ < slot_limit)
+    {
+      fallback_.erase(blocks, next);
+      add_free(blocks, next);
+    }
+  }
+
+  fallback_strat                        fallback_;
+  std::array<std::uint32_t, max_bucket> heads_ = {};
+};
+
+} // namespace ouly::strat
@@ -0,0 +1,318 @@
+#pragma once
+
+#include "ouly/allocators/config.hpp"
+#include "ouly/allocators/detail/arena.hpp"
+#include "ouly/allocators/strat/best_fit_v2.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <type_traits>
+
+namespace ouly::strat
+{
+
+/**
+ * @brief Strategy class for arena_allocator that keeps small free blocks in fixed capacity slots.
+ *
+ * Works like @ref slotted_v0, but each slot is a fixed array of at most fixed_max_per_slot block ids instead of a list
+ * threaded through the blocks, and a bitmap of non empty slots finds the first candidate in the search window with
+ * std::countr_zero. Taking or removing a block swaps it with the last entry of its slot, so no block is visited besides
+ * the one returned. Free blocks that find their slot full are handed to the fallback strategy.
+ *
+ * Options:
+ * - cfg::granularity: size covered by a slot, default 256
+ * - cfg::max_bucket: number of slots, default 255
+ * - cfg::search_window: slots looked at before the fallback, default 4
+ * - cfg::fixed_max_per_slot: capacity of a slot, default 8
+ * - cfg::fallback_start: strategy for the larger blocks and slot overflow, default best_fit_v2
+ */
+template <typename Config = ouly::config<>>
+class slotted_v1
+{
+public:
+  using fallback_strat  = ouly::detail::fallback_strat_t<Config, best_fit_v2<Config>>;
+  using fallback_result = typename fallback_strat::allocate_result;
+  using extension       = typename fallback_strat::extension;
+  using size_type       = ouly::detail::choose_size_t<uint32_t, Config>;
+  using arena_bank      = ouly::detail::arena_bank<size_type, extension>;
+  using block_bank      = ouly::detail::block_bank<size_type, extension>;
+  using block           = ouly::detail::block<size_type, extension>;
+  using bank_data       = ouly::detail::bank_data<size_type, extension>;
+  using block_link      = typename block_bank::link;
+
+  static_assert(std::is_same_v<typename fallback_strat::size_type, size_type>,
+                "Fallback strategy must use the same size type");
+
+  static constexpr size_type min_granularity    = 4;
+  static constexpr size_type granularity        = static_cast<size_type>(ouly::detail::granularity_v<Config>);
+  static constexpr uint32_t  max_bucket         = static_cast<uint32_t>(ouly::detail::max_bucket_v<Config>);
+  static constexpr uint32_t  search_window      = static_cast<uint32_t>(ouly::detail::search_window_v<Config>);
+  static constexpr uint32_t  fixed_max_per_slot = static_cast<uint32_t>(ouly::detail::fixed_max_per_slot_v<Config>);
+  static constexpr size_type slot_limit         = granularity * max_bucket;
+
+  struct allocate_result
+  {
+    std::uint32_t   block_    = 0;
+    fallback_result fallback_ = {};
+
+    explicit operator bool() const noexcept
+    {
+      return block_ != 0 || static_cast<bool>(fallback_);
+    }
+  };
+
+  slotted_v1() noexcept             = default;
+  slotted_v1(slotted_v1 const&)     = default;
+  slotted_v1(slotted_v1&&) noexcept = default;
+  ~slotted_v1() noexcept            = default;
+
+  auto operator=(slotted_v1 const&) -> slotted_v1&     = default;
+  auto operator=(slotted_v1&&) noexcept -> slotted_v1& = default;
+
+  [[nodiscard]] auto try_allocate(bank_data& bank, size_type size) -> allocate_result
+  {
+    if (size >= slot_limit)
+    {
+      return {0, fallback_.try_allocate(bank, size)};
+    }
+
+    // Any block in a slot at or above the rounded up size fits
+    auto first = static_cast<uint32_t>((size + granularity - 1) / granularity);
+    auto last  = std::min(first + search_window, max_bucket);
+    if (auto slot = find_occupied(first, last); slot != max_bucket)
+    {
+      return {slot_back(slot)};
+    }
+
+    auto const& own = slots_[size / granularity];
+    for (uint32_t i = 0; i < own.count_; ++i)
+    {
+      if (bank.blocks_[block_link(own.blocks_[i])].size_ >= size)
+      {
+        return {own.blocks_[i]};
+      }
+    }
+
+    if (auto found = fallback_.try_allocate(bank, size))
+    {
+      return {0, found};
+    }
+
+    if (auto slot = find_occupied(last, max_bucket); slot != max_bucket)
+    {
+      return {slot_back(slot)};
+    }
+    return {};
+  }
+
+  auto commit(bank_data& bank, size_type size, allocate_result found) -> std::uint32_t
+  {
+    if (found.block_ == 0)
+    {
+      auto id = fallback_.commit(bank, size, found.fallback_);
+      reclaim_remainder(bank.blocks_, id);
+      return id;
+    }
+
+    erase(bank.blocks_, found.block_);
+
+    auto& blk = bank.blocks_[block_link(found.block_)];
+    // Marker
+    blk.is_free_ = false;
+
+    auto remaining = blk.size_ - size;
+    blk.size_      = size;
+    if (remaining > 0)
+    {
+      auto& list  = bank.arenas_[blk.arena_].block_order();
+      auto  arena = blk.arena_;
+
+      auto newblk = bank.blocks_.emplace(blk.offset_ + size, remaining, arena, 0U, true);
+      list.insert_after(bank.blocks_, found.block_, (uint32_t)newblk);
+      add_free(bank.blocks_, (uint32_t)newblk);
+    }
+    return found.block_;
+  }
+
+  void add_free_arena(block_bank& blocks, std::uint32_t block)
+  {
+    if (blocks[block_link(block)].size_ >= slot_limit)
+    {
+      fallback_.add_free_arena(blocks, block);
+    }
+    else
+    {
+      add_free(blocks, block);
+    }
+  }
+
+  void add_free(block_bank& blocks, std::uint32_t block)
+  {
+    auto& blk = blocks[block_link(block)];
+    if (blk.size_ >= slot_limit || slots_[blk.size_ / granularity].count_ == fixed_max_per_slot)
+    {
+      // The block may come out of a slot, clear what the slot left in the fallback's links
+      blk.ext_ = extension();
+      fallback_.add_free(blocks, block);
+      return;
+    }
+
+    auto  index                 = static_cast<uint32_t>(blk.size_ / granularity);
+    auto& slot                  = slots_[index];
+    blk.is_slotted_             = true;
+    blk.data_                   = slot.count_;
+    slot.blocks_[slot.count_++] = block;
+    occupied_[index / 64] |= (uint64_t{1} << (index % 64));
+  }
+
+  void grow_free_node(block_bank& blocks, std::uint32_t block, size_type newsize)
+  {
+    if (!blocks[block_link(block)].is_slotted_)
+    {
+      fallback_.grow_free_node(blocks, block, newsize);
+      return;
+    }
+    erase(blocks, block);
+    blocks[block_link(block)].size_ = newsize;
+    add_free(blocks, block);
+  }
+
+  void replace_and_grow(block_bank& blocks, std::uint32_t block, std::uint32_t new_block, size_type new_size)
+  {
+    if (!blocks[block_link(block)].is_slotted_)
+    {
+      blocks[block_link(new_block)].ext_ = extension();
+      fallback_.replace_and_grow(blocks, block, new_block, new_size);
+      return;
+    }
+    erase(blocks, block);
+    blocks[block_link(new_block)].size_ = new_size;
+    add_free(blocks, new_block);
+  }
+
+  void erase(block_bank& blocks, std::uint32_t node)
+  {
+    auto& blk = blocks[block_link(node)];
+    if (!blk.is_slotted_)
+    {
+      fallback_.erase(blocks, node);
+      return;
+    }
+
+    auto  index = static_cast<uint32_t>(blk.size_ / granularity);
+    auto& slot  = slots_[index];
+    auto  moved = slot.blocks_[--slot.count_];
+    if (moved != node)
+    {
+      slot.blocks_[blk.data_]         = moved;
+      blocks[block_link(moved)].data_ = blk.data_;
+    }
+    if (slot.count_ == 0)
+    {
+      occupied_[index / 64] &= ~(uint64_t{1} << (index % 64));
+    }
+    blk.is_slotted_ = false;
+  }
+
+  auto total_free_nodes(block_bank const& blocks) const -> std::uint32_t
+  {
+    uint32_t count = fallback_.total_free_nodes(blocks);
+    for (auto const& slot : slots_)
+    {
+      count += slot.count_;
+    }
+    return count;
+  }
+
+  auto total_free_size(block_bank const& blocks) const -> size_type
+  {
+    size_type sz = fallback_.total_free_size(blocks);
+    for (auto const& slot : slots_)
+    {
+      for (uint32_t i = 0; i < slot.count_; ++i)
+      {
+        sz += blocks[block_link(slot.blocks_[i])].size_;
+      }
+    }
+    return sz;
+  }
+
+  void validate_integrity(block_bank const& blocks) const
+  {
+    for (uint32_t index = 0; index < max_bucket; ++index)
+    {
+      auto const& slot = slots_[index];
+      assert(((occupied_[index / 64] >> (index % 64)) & 1U) == (slot.count_ != 0 ? 1U : 0U));
+      for (uint32_t i = 0; i < slot.count_; ++i)
+      {
+        auto const& blk = blocks[block_link(slot.blocks_[i])];
+        assert(blk.is_free_ && blk.is_slotted_);
+        assert(blk.size_ / granularity == index);
+        assert(blk.data_ == i);
+      }
+    }
+    fallback_.validate_integrity(blocks);
+  }
+
+  template <typename Owner>
+  void init(Owner const& owner)
+  {
+    fallback_.init(owner);
+  }
+
+private:
+  static constexpr uint32_t word_count = (max_bucket + 63) / 64;
+
+  struct slot_data
+  {
+    std::array<std::uint32_t, fixed_max_per_slot> blocks_ = {};
+    std::uint32_t                                 count_  = 0;
+  };
+
+  [[nodiscard]] auto slot_back(uint32_t index) const noexcept -> std::uint32_t
+  {
+    return slots_[index].blocks_[slots_[index].count_ - 1];
+  }
+
+  /**
+   * @brief First non empty slot in [from, to), or max_bucket
+   */
+  [[nodiscard]] auto find_occupied(uint32_t from, uint32_t to) const noexcept -> uint32_t
+  {
+    for (uint32_t word = from / 64; from < to; ++word, from = word * 64)
+    {
+      auto bits = occupied_[word] & (~uint64_t{0} << (from % 64));
+      if (bits != 0U)
+      {
+        auto index = (word * 64) + static_cast<uint32_t>(std::countr_zero(bits));
+        return index < to ? index : max_bucket;
+      }
+    }
+    return max_bucket;
+  }
+
+  /**
+   * @brief Moves the part left over by a fallback allocation into the slots if it is small enough
+   */
+  void reclaim_remainder(block_bank& blocks, std::uint32_t id)
+  {
+    auto next = blocks[block_link(id)].arena_order_.next_;
+    if (next == 0U)
+    {
+      return;
+    }
+    auto const& blk = blocks[block_link(next)];
+    if (blk.is_free_ && !blk.is_slotted_ && blk.size_ < slot_limit &&
+        slots_[blk.size_ / granularity].count_ < fixed_max_per_slot)
+    {
+      fallback_.erase(blocks, next);
+      add_free(blocks, next);
+    }
+  }
+
+  fallback_strat                        fallback_;
+  std::array<slot_data, max_bucket>     slots_    = {};
+  std::array<std::uint64_t, word_count> occupied_ = {};
+};
+
+} // namespace ouly::strat
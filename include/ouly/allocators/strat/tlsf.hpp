@@ -0,0 +1,284 @@
+#pragma once
+
+#include "ouly/allocators/config.hpp"
+#include "ouly/allocators/detail/arena.hpp"
+#include "ouly/utility/optional_val.hpp"
+#include <array>
+#include <bit>
+#include <limits>
+#include <utility>
+
+namespace ouly::strat
+{
+
+/**
+ * @brief Two level segregated fit strategy for arena_allocator.
+ *
+ * Free blocks are kept in one list per size class. The first level splits sizes by power of two, the second level
+ * splits every power of two range in sl_count linear classes. One bitmap per level tracks the non empty lists, so
+ * finding a list that can serve a request takes two std::countr_zero and allocation and free cost does not depend on
+ * the number of free blocks.
+ *
+ * Requests are rounded up to the next class boundary before the search, any block in the found list fits without
+ * walking it (good fit rather than best fit). If no such list exists, the list of the request's own class is scanned
+ * as a fallback before giving up.
+ */
+template <typename Config = ouly::config<>>
+class tlsf
+{
+  static constexpr uint32_t k_null_0 = 0;
+  using optional_addr                = ouly::optional_val<k_null_0>;
+
+public:
+  using extension       = uint64_t;
+  using size_type       = ouly::detail::choose_size_t<uint32_t, Config>;
+  using arena_bank      = ouly::detail::arena_bank<size_type, extension>;
+  using block_bank      = ouly::detail::block_bank<size_type, extension>;
+  using block           = ouly::detail::block<size_type, extension>;
+  using bank_data       = ouly::detail::bank_data<size_type, extension>;
+  using block_link      = typename block_bank::link;
+  using allocate_result = optional_addr;
+
+  static constexpr size_type min_granularity = 4;
+  static constexpr uint32_t  sl_bits         = 4;
+  static constexpr uint32_t  sl_count        = 1U << sl_bits;
+  static constexpr uint32_t  fl_count        = std::numeric_limits<size_type>::digits - sl_bits + 1;
+
+  static_assert(fl_count <= 64, "First level bitmap is 64 bits wide");
+
+  tlsf() noexcept       = default;
+  tlsf(tlsf const&)     = default;
+  tlsf(tlsf&&) noexcept = default;
+  ~tlsf() noexcept      = default;
+
+  auto operator=(tlsf const&) -> tlsf&     = default;
+  auto operator=(tlsf&&) noexcept -> tlsf& = default;
+
+  [[nodiscard]] auto try_allocate(bank_data& bank, size_type size) -> optional_addr
+  {
+    auto [fl, sl] = mapping(round_up(size));
+    if (auto found = find_suitable(fl, sl))
+    {
+      return found;
+    }
+
+    // The rounded search skips the request's own class, blocks there may still be large enough
+    auto [efl, esl] = mapping(size);
+    uint32_t i      = heads_[efl][esl];
+    while (i != 0U)
+    {
+      auto const& blk = bank.blocks_[block_link(i)];
+      if (blk.size_ >= size)
+      {
+        return {i};
+      }
+      i = blk.list_.next_;
+    }
+    return {};
+  }
+
+  auto commit(bank_data& bank, size_type size, optional_addr found) -> std::uint32_t
+  {
+    erase(bank.blocks_, found.value_);
+
+    auto& blk = bank.blocks_[block_link(found.value_)];
+    // Marker
+    blk.is_free_ = false;
+
+    auto remaining = blk.size_ - size;
+    blk.size_      = size;
+    if (remaining > 0)
+    {
+      auto& list  = bank.arenas_[blk.arena_].block_order();
+      auto  arena = blk.arena_;
+
+      auto newblk = bank.blocks_.emplace(blk.offset_ + size, remaining, arena, ouly::detail::list_node(), true);
+      list.insert_after(bank.blocks_, found.value_, (uint32_t)newblk);
+      add_free(bank.blocks_, (uint32_t)newblk);
+    }
+    return found.value_;
+  }
+
+  void add_free_arena(block_bank& blocks, std::uint32_t block)
+  {
+    add_free(blocks, block);
+  }
+
+  void add_free(block_bank& blocks, std::uint32_t block)
+  {
+    auto& blk       = blocks[block_link(block)];
+    auto [fl, sl]   = mapping(blk.size_);
+    auto& head      = heads_[fl][sl];
+    blk.list_.prev_ = 0;
+    blk.list_.next_ = head;
+    if (head != 0U)
+    {
+      blocks[block_link(head)].list_.prev_ = block;
+    }
+    head = block;
+    fl_bitmap_ |= (uint64_t{1} << fl);
+    sl_bitmap_[fl] |= (1U << sl);
+  }
+
+  void grow_free_node(block_bank& blocks, std::uint32_t block, size_type newsize)
+  {
+    erase(blocks, block);
+    blocks[block_link(block)].size_ = newsize;
+    add_free(blocks, block);
+  }
+
+  void replace_and_grow(block_bank& blocks, std::uint32_t block, std::uint32_t new_block, size_type new_size)
+  {
+    erase(blocks, block);
+    blocks[block_link(new_block)].size_ = new_size;
+    add_free(blocks, new_block);
+  }
+
+  void erase(block_bank& blocks, std::uint32_t node)
+  {
+    auto& blk     = blocks[block_link(node)];
+    auto [fl, sl] = mapping(blk.size_);
+    if (blk.list_.next_)
+    {
+      blocks[block_link(blk.list_.next_)].list_.prev_ = blk.list_.prev_;
+    }
+    if (blk.list_.prev_)
+    {
+      blocks[block_link(blk.list_.prev_)].list_.next_ = blk.list_.next_;
+    }
+    else
+    {
+      heads_[fl][sl] = blk.list_.next_;
+      if (heads_[fl][sl] == 0U)
+      {
+        sl_bitmap_[fl] &= ~(1U << sl);
+        if (sl_bitmap_[fl] == 0U)
+        {
+          fl_bitmap_ &= ~(uint64_t{1} << fl);
+        }
+      }
+    }
+    blk.list_ = {};
+  }
+
+  auto total_free_nodes(block_bank const& blocks) const -> std::uint32_t
+  {
+    uint32_t count = 0;
+    for_each_free(blocks,
+                  [&count](block const& blk)
+                  {
+                    assert(blk.size_);
+                    count++;
+                  });
+    return count;
+  }
+
+  auto total_free_size(block_bank const& blocks) const -> size_type
+  {
+    size_type sz = 0;
+    for_each_free(blocks,
+                  [&sz](block const& blk)
+                  {
+                    sz += blk.size_;
+                  });
+    return sz;
+  }
+
+  void validate_integrity(block_bank const& blocks) const
+  {
+    for (uint32_t fl = 0; fl < fl_count; ++fl)
+    {
+      assert(((fl_bitmap_ >> fl) & 1U) == (sl_bitmap_[fl] != 0U ? 1U : 0U));
+      for (uint32_t sl = 0; sl < sl_count; ++sl)
+      {
+        assert(((sl_bitmap_[fl] >> sl) & 1U) == (heads_[fl][sl] != 0U ? 1U : 0U));
+        uint32_t i = heads_[fl][sl];
+        uint32_t p = 0;
+        while (i != 0U)
+        {
+          auto const& blk = blocks[block_link(i)];
+          assert(blk.is_free_);
+          assert(blk.list_.prev_ == p);
+          assert(mapping(blk.size_).first == fl && mapping(blk.size_).second == sl);
+          p = i;
+          i = blk.list_.next_;
+        }
+      }
+    }
+  }
+
+  template <typename Owner>
+  void init([[maybe_unused]] Owner const& owner)
+  {}
+
+private:
+  /**
+   * @brief First and second level index of the class holding size, sizes below sl_count map linearly to level 0
+   */
+  static constexpr auto mapping(size_type size) noexcept -> std::pair<uint32_t, uint32_t>
+  {
+    if (size < sl_count)
+    {
+      return {0U, static_cast<uint32_t>(size)};
+    }
+    auto const p = static_cast<uint32_t>(std::bit_width(size)) - 1;
+    return {p - sl_bits + 1, static_cast<uint32_t>(size >> (p - sl_bits)) ^ sl_count};
+  }
+
+  /**
+   * @brief Rounds size up to the next class boundary, so that every block of its class is large enough
+   */
+  static constexpr auto round_up(size_type size) noexcept -> size_type
+  {
+    if (size < sl_count)
+    {
+      return size;
+    }
+    auto const round = (size_type{1} << (static_cast<uint32_t>(std::bit_width(size)) - 1 - sl_bits)) - 1;
+    if (size > std::numeric_limits<size_type>::max() - round)
+    {
+      return size;
+    }
+    return size + round;
+  }
+
+  [[nodiscard]] auto find_suitable(uint32_t fl, uint32_t sl) const noexcept -> optional_addr
+  {
+    auto sl_map = sl_bitmap_[fl] & (~0U << sl);
+    if (sl_map == 0U)
+    {
+      auto fl_map = fl_bitmap_ & (~uint64_t{0} << (fl + 1));
+      if (fl_map == 0U)
+      {
+        return {};
+      }
+      fl     = static_cast<uint32_t>(std::countr_zero(fl_map));
+      sl_map = sl_bitmap_[fl];
+    }
+    return {heads_[fl][static_cast<uint32_t>(std::countr_zero(sl_map))]};
+  }
+
+  template <typename Fn>
+  void for_each_free(block_bank const& blocks, Fn&& fn) const
+  {
+    for (uint32_t fl = 0; fl < fl_count; ++fl)
+    {
+      for (uint32_t sl = 0; sl < sl_count; ++sl)
+      {
+        uint32_t i = heads_[fl][sl];
+        while (i != 0U)
+        {
+          auto const& blk = blocks[block_link(i)];
+          fn(blk);
+          i = blk.list_.next_;
+        }
+      }
+    }
+  }
+
+  uint64_t                                             fl_bitmap_ = 0;
+  std::array<uint32_t, fl_count>                       sl_bitmap_ = {};
+  std::array<std::array<uint32_t, sl_count>, fl_count> heads_     = {};
+};
+
+} // namespace ouly::strat
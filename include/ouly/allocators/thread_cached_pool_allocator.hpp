@@ -0,0 +1,315 @@
+#pragma once
+
+#include "ouly/allocators/pool_allocator.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ouly
+{
+
+struct thread_cached_pool_allocator_tag
+{};
+
+namespace detail
+{
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+inline std::atomic_uint64_t thread_cache_owner_counter = 0;
+} // namespace detail
+
+/**
+ * @brief A thread safe front end for @ref pool_allocator that keeps single atoms in per thread magazines.
+ *
+ * Single atom allocations and deallocations only touch the calling thread's magazine. When the magazine runs empty it
+ * is refilled with half a magazine of atoms from a shared depot, a pool_allocator behind a mutex, and when it is full
+ * half of it is flushed back. The depot lock is therefore taken once per magazine_size/2 operations at most. Requests
+ * larger than an atom, or with an alignment the atoms cannot satisfy, go straight to the depot.
+ *
+ * Statistics are counted per thread and merged into the allocator's statistics whenever the thread visits the depot,
+ * and when the allocator is destroyed.
+ *
+ * Options:
+ * - cfg::atom_size, cfg::atom_count: as for pool_allocator
+ * - cfg::magazine_size: atoms cached per thread, default 64
+ * - cfg::underlying_allocator: allocator for the depot's arenas
+ *
+ * @note Atoms held by a thread stay in its magazine until the thread calls flush_thread_cache() or exits, or the
+ * allocator is destroyed. A thread that exits returns its magazine to the depot and releases it.
+ */
+template <typename Config = ouly::config<>>
+class thread_cached_pool_allocator : ouly::detail::statistics<thread_cached_pool_allocator_tag, Config>
+{
+  using underlying_allocator = ouly::detail::underlying_allocator_t<Config>;
+  using depot_type           = pool_allocator<ouly::config<cfg::underlying_allocator<underlying_allocator>>>;
+
+public:
+  using tag                                = thread_cached_pool_allocator_tag;
+  using statistics                         = ouly::detail::statistics<thread_cached_pool_allocator_tag, Config>;
+  using size_type                          = typename depot_type::size_type;
+  using address                            = typename depot_type::address;
+  static constexpr auto default_atom_size  = ouly::detail::atom_size<Config>::value;
+  static constexpr auto default_atom_count = ouly::detail::atom_count<Config>::value;
+  static constexpr auto magazine_size      = ouly::detail::magazine_size<Config>::value;
+  static constexpr auto batch_size         = magazine_size / 2;
+
+  thread_cached_pool_allocator() noexcept
+      : thread_cached_pool_allocator(static_cast<size_type>(default_atom_size),
+                                     static_cast<size_type>(default_atom_count))
+  {}
+
+  thread_cached_pool_allocator(size_type i_atom_size, size_type i_atom_count)
+      : depot_(i_atom_size, i_atom_count), link_(std::make_shared<owner_link>()), atom_size_(i_atom_size),
+        id_(ouly::detail::thread_cache_owner_counter.fetch_add(1, std::memory_order_relaxed) + 1)
+  {
+    link_->owner_ = this;
+    assert(i_atom_size >= sizeof(void*) && "Atoms must be able to hold a pointer");
+  }
+
+  thread_cached_pool_allocator(thread_cached_pool_allocator const&)                    = delete;
+  thread_cached_pool_allocator(thread_cached_pool_allocator&&)                         = delete;
+  auto operator=(thread_cached_pool_allocator const&) -> thread_cached_pool_allocator& = delete;
+  auto operator=(thread_cached_pool_allocator&&) -> thread_cached_pool_allocator&      = delete;
+
+  ~thread_cached_pool_allocator() noexcept
+  {
+    {
+      // Waits for exiting threads that are returning their magazine
+      auto lck      = std::scoped_lock(link_->lock_);
+      link_->owner_ = nullptr;
+    }
+    for (auto& cache : caches_)
+    {
+      merge_stats(*cache);
+    }
+  }
+
+  constexpr static auto null() -> address
+  {
+    return depot_type::null();
+  }
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] auto allocate(size_type size_value, Alignment alignment = {}) -> address
+  {
+    if (!is_cached(size_value, (size_t)alignment))
+    {
+      auto                  lck     = std::scoped_lock(depot_lock_);
+      [[maybe_unused]] auto measure = statistics::report_allocate(size_value);
+      return depot_.allocate(size_value, alignment);
+    }
+
+    auto& cache = local_cache();
+    if (cache.count_ == 0)
+    {
+      refill(cache);
+    }
+    cache.allocations_++;
+    cache.allocated_ += size_value;
+    return cache.atoms_[--cache.count_];
+  }
+
+  template <typename Alignment = alignment<>>
+  void deallocate(address i_ptr, size_type size_value, Alignment alignment = {})
+  {
+    if (!is_cached(size_value, (size_t)alignment))
+    {
+      auto                  lck     = std::scoped_lock(depot_lock_);
+      [[maybe_unused]] auto measure = statistics::report_deallocate(size_value);
+      depot_.deallocate(i_ptr, size_value, alignment);
+      return;
+    }
+
+    auto& cache = local_cache();
+    if (cache.count_ == magazine_size)
+    {
+      flush(cache, batch_size);
+    }
+    cache.deallocations_++;
+    cache.deallocated_ += size_value;
+    cache.atoms_[cache.count_++] = i_ptr;
+  }
+
+  /**
+   * @brief Returns the atoms cached by the calling thread to the depot, call before a thread stops using the allocator
+   */
+  void flush_thread_cache()
+  {
+    auto& cache = local_cache();
+    flush(cache, cache.count_);
+  }
+
+  /**
+   * @brief Number of atoms cached by the calling thread
+   */
+  [[nodiscard]] auto get_thread_cache_count() -> uint32_t
+  {
+    return local_cache().count_;
+  }
+
+  [[nodiscard]] auto get_atom_size() const noexcept -> size_type
+  {
+    return atom_size_;
+  }
+
+  using statistics::print;
+
+private:
+  struct thread_cache
+  {
+    std::array<address, magazine_size> atoms_{};
+    uint32_t                           count_         = 0;
+    // Counters not yet merged into the allocator statistics
+    uint64_t                           allocations_   = 0;
+    uint64_t                           deallocations_ = 0;
+    std::size_t                        allocated_     = 0;
+    std::size_t                        deallocated_   = 0;
+  };
+
+  /**
+   * @brief Shared by the allocator and the threads using it, lets an exiting thread find a live allocator
+   */
+  struct owner_link
+  {
+    std::mutex                    lock_;
+    thread_cached_pool_allocator* owner_ = nullptr;
+  };
+
+  struct cache_entry
+  {
+    uint64_t                  owner_ = 0;
+    thread_cache*             cache_ = nullptr;
+    // Expires with the allocator, so the thread can drop the entry
+    std::weak_ptr<owner_link> link_;
+  };
+
+  /**
+   * @brief Caches of the calling thread, their magazines are returned when the thread exits
+   */
+  struct thread_cache_list
+  {
+    std::vector<cache_entry> entries_;
+
+    thread_cache_list() noexcept                                   = default;
+    thread_cache_list(thread_cache_list const&)                    = delete;
+    thread_cache_list(thread_cache_list&&)                         = delete;
+    auto operator=(thread_cache_list const&) -> thread_cache_list& = delete;
+    auto operator=(thread_cache_list&&) -> thread_cache_list&      = delete;
+
+    ~thread_cache_list() noexcept
+    {
+      for (auto const& entry : entries_)
+      {
+        if (auto link = entry.link_.lock())
+        {
+          auto lck = std::scoped_lock(link->lock_);
+          if (link->owner_ != nullptr)
+          {
+            link->owner_->release(entry.cache_);
+          }
+        }
+      }
+    }
+  };
+
+  [[nodiscard]] auto is_cached(size_type size_value, size_t alignment_value) const noexcept -> bool
+  {
+    if (size_value > atom_size_)
+    {
+      return false;
+    }
+    return alignment_value <= 1 ||
+           (alignment_value <= alignof(std::max_align_t) && (atom_size_ % alignment_value) == 0);
+  }
+
+  static auto thread_caches() -> std::vector<cache_entry>&
+  {
+    thread_local thread_cache_list caches;
+    return caches.entries_;
+  }
+
+  auto local_cache() -> thread_cache&
+  {
+    auto& caches = thread_caches();
+    for (auto const& entry : caches)
+    {
+      if (entry.owner_ == id_)
+      {
+        return *entry.cache_;
+      }
+    }
+
+    // Entries of destroyed allocators are dropped whenever the thread meets a new allocator
+    std::erase_if(caches,
+                  [](cache_entry const& entry)
+                  {
+                    return entry.link_.expired();
+                  });
+
+    auto  lck   = std::scoped_lock(depot_lock_);
+    auto* cache = caches_.emplace_back(std::make_unique<thread_cache>()).get();
+    caches.push_back(cache_entry{.owner_ = id_, .cache_ = cache, .link_ = link_});
+    return *cache;
+  }
+
+  /**
+   * @brief Returns the magazine of an exiting thread to the depot and drops its cache
+   */
+  void release(thread_cache* cache) noexcept
+  {
+    auto lck = std::scoped_lock(depot_lock_);
+    while (cache->count_ != 0)
+    {
+      depot_.deallocate(cache->atoms_[--cache->count_], atom_size_);
+    }
+    merge_stats(*cache);
+    std::erase_if(caches_,
+                  [cache](std::unique_ptr<thread_cache> const& c)
+                  {
+                    return c.get() == cache;
+                  });
+  }
+
+  void merge_stats(thread_cache& cache)
+  {
+    // Only the net change is merged, the churn inside the magazine never raised the allocated size
+    auto allocated   = cache.allocated_ > cache.deallocated_ ? cache.allocated_ - cache.deallocated_ : 0;
+    auto deallocated = cache.deallocated_ > cache.allocated_ ? cache.deallocated_ - cache.allocated_ : 0;
+    statistics::report_merge(cache.allocations_, cache.deallocations_, allocated, deallocated);
+    cache.allocations_   = 0;
+    cache.deallocations_ = 0;
+    cache.allocated_     = 0;
+    cache.deallocated_   = 0;
+  }
+
+  void refill(thread_cache& cache)
+  {
+    auto lck = std::scoped_lock(depot_lock_);
+    for (; cache.count_ < batch_size; ++cache.count_)
+    {
+      cache.atoms_[cache.count_] = depot_.allocate(atom_size_);
+    }
+    merge_stats(cache);
+  }
+
+  void flush(thread_cache& cache, uint32_t count)
+  {
+    auto lck = std::scoped_lock(depot_lock_);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      depot_.deallocate(cache.atoms_[--cache.count_], atom_size_);
+    }
+    merge_stats(cache);
+  }
+
+  std::mutex                                 depot_lock_;
+  depot_type                                 depot_;
+  std::vector<std::unique_ptr<thread_cache>> caches_;
+  std::shared_ptr<owner_link>                link_;
+  size_type                                  atom_size_ = 0;
+  uint64_t                                   id_        = 0;
+};
+
+} // namespace ouly
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "ouly/allocators/alignment.hpp"
+#include "ouly/allocators/config.hpp"
+#include "ouly/utility/common.hpp"
+#include "ouly/utility/detail/concepts.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace ouly
+{
+
+struct vm_allocator_tag
+{};
+
+namespace detail
+{
+template <typename O>
+concept HasPageMode = requires { O::page_mode_v; };
+
+template <typename T>
+struct page_mode
+{
+  static constexpr auto value = cfg::vm_page_mode::e_default;
+};
+
+template <HasPageMode T>
+struct page_mode<T>
+{
+  static constexpr auto value = T::page_mode_v;
+};
+
+/**
+ * @brief Granularity of reservations and commits, the system page size, or the huge page size for huge page modes
+ */
+OULY_API auto vm_granularity(cfg::vm_page_mode mode) noexcept -> std::size_t;
+/**
+ * @brief Reserves address space without backing memory, the size is rounded up to vm_granularity(mode). Returns
+ * nullptr on failure.
+ */
+OULY_API auto vm_reserve(std::size_t size, cfg::vm_page_mode mode) noexcept -> void*;
+/**
+ * @brief Makes a reserved range readable and writable, physical pages are provided by the system on first touch
+ */
+OULY_API auto vm_commit(void* addr, std::size_t size) noexcept -> bool;
+/**
+ * @brief Returns the physical pages of a committed range to the system and makes it inaccessible again
+ */
+OULY_API void vm_decommit(void* addr, std::size_t size) noexcept;
+/**
+ * @brief Releases a range obtained from vm_reserve, size and mode must match the reservation
+ */
+OULY_API void vm_release(void* addr, std::size_t size, cfg::vm_page_mode mode) noexcept;
+} // namespace detail
+
+/**
+ * @brief Memory manager for @ref arena_allocator that places arenas in one virtual memory reservation.
+ *
+ * The manager reserves max_arenas slots of max_arena_size bytes each up front without backing memory. Adding an arena
+ * commits only the requested size in a free slot, dropping or removing it decommits the pages (MADV_DONTNEED on POSIX,
+ * MEM_DECOMMIT on Windows) so the resident size follows the arenas in use. Arena addresses never change, and an arena
+ * can be grown in place up to the slot size with grow_arena(). arena_allocator never resizes its arenas, so
+ * grow_arena() is only for code that manages the arena memory directly.
+ *
+ * The handle returned by add_arena() is the slot index, use get_arena_data() to get the arena memory. When no slot is
+ * left, the size exceeds the slot size or the commit fails, add_arena() returns invalid_arena and the allocation that
+ * needed the arena fails.
+ *
+ * @code
+ * ouly::vm_arena_manager mgr(64 * 1024 * 1024, 256);
+ * using allocator_t = ouly::arena_allocator<ouly::config<ouly::cfg::manager<ouly::vm_arena_manager>>>;
+ * allocator_t allocator(16 * 1024 * 1024, mgr);
+ * auto [arena, alloc, offset] = allocator.allocate(1024);
+ * void* memory = static_cast<std::byte*>(mgr.get_arena_data(arena)) + offset;
+ * @endcode
+ *
+ * @note cfg::vm_page_mode::e_transparent_huge and e_huge_tlb round slots up to the huge page size. e_huge_tlb takes
+ * the huge pages for the whole reservation from the system pool up front, and uses regular pages if the pool is too
+ * small. Huge pages are not used on Windows. The manager is not thread safe.
+ */
+class vm_arena_manager
+{
+public:
+  static constexpr std::uint32_t invalid_arena = std::numeric_limits<std::uint32_t>::max();
+
+  vm_arena_manager() noexcept = default;
+  OULY_API vm_arena_manager(std::size_t max_arena_size, std::uint32_t max_arenas,
+                            cfg::vm_page_mode mode = cfg::vm_page_mode::e_default) noexcept;
+  vm_arena_manager(vm_arena_manager const&) = delete;
+  OULY_API vm_arena_manager(vm_arena_manager&& other) noexcept;
+  OULY_API ~vm_arena_manager() noexcept;
+
+  auto operator=(vm_arena_manager const&) -> vm_arena_manager& = delete;
+  OULY_API auto operator=(vm_arena_manager&& other) noexcept -> vm_arena_manager&;
+
+  /**
+   * @brief Commits size bytes in a free slot and returns the slot, or invalid_arena if no slot is left
+   */
+  OULY_API auto add_arena(std::uint32_t id, std::size_t size) -> std::uint32_t;
+  /**
+   * @brief Called when an arena becomes empty, its pages are returned to the system and the slot is freed
+   */
+  OULY_API auto drop_arena(std::uint32_t slot) -> bool;
+  OULY_API void remove_arena(std::uint32_t slot);
+
+  /**
+   * @brief Commits the arena up to size bytes in place, fails if size exceeds the slot size
+   */
+  OULY_API auto grow_arena(std::uint32_t slot, std::size_t size) -> bool;
+
+  [[nodiscard]] auto get_arena_data(std::uint32_t slot) const noexcept -> void*
+  {
+    return base_ + (static_cast<std::size_t>(slot) * slot_size_);
+  }
+
+  [[nodiscard]] auto get_arena_size(std::uint32_t slot) const noexcept -> std::size_t
+  {
+    return committed_[slot];
+  }
+
+  /**
+   * @brief Bytes committed over all arenas, rounded to the commit granularity
+   */
+  [[nodiscard]] auto get_committed_size() const noexcept -> std::size_t
+  {
+    return committed_size_;
+  }
+
+  [[nodiscard]] auto get_slot_size() const noexcept -> std::size_t
+  {
+    return slot_size_;
+  }
+
+private:
+  void release_slot(std::uint32_t slot) noexcept;
+
+  std::uint8_t*              base_           = nullptr;
+  std::size_t                slot_size_      = 0;
+  std::size_t                granularity_    = 0;
+  std::size_t                committed_size_ = 0;
+  std::vector<std::size_t>   committed_;
+  std::vector<std::uint32_t> free_slots_;
+  std::uint32_t              max_arenas_     = 0;
+  cfg::vm_page_mode          mode_           = cfg::vm_page_mode::e_default;
+};
+
+/**
+ * @brief Underlying allocator that maps every allocation directly from the system.
+ *
+ * Meant as the cfg::underlying_allocator of allocators that request large blocks, such as @ref linear_arena_allocator
+ * and @ref linear_stack_allocator. Blocks are page aligned, only touched pages become resident, and deallocation
+ * returns the whole range to the system immediately. cfg::page_mode selects huge pages.
+ */
+template <typename Config = ouly::config<>>
+struct vm_allocator
+{
+  using tag       = vm_allocator_tag;
+  using address   = void*;
+  using size_type = ouly::detail::choose_size_t<std::size_t, Config>;
+
+  static constexpr auto page_mode = ouly::detail::page_mode<Config>::value;
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] static auto allocate(size_type size, [[maybe_unused]] Alignment alignment = {}) -> address
+  {
+    assert(static_cast<std::size_t>(alignment) <= ouly::detail::vm_granularity(cfg::vm_page_mode::e_default));
+    auto  granularity = ouly::detail::vm_granularity(page_mode);
+    auto  rounded     = ((size + granularity - 1) / granularity) * granularity;
+    void* ptr         = ouly::detail::vm_reserve(rounded, page_mode);
+    if (ptr != nullptr && !ouly::detail::vm_commit(ptr, rounded))
+    {
+      ouly::detail::vm_release(ptr, rounded, page_mode);
+      return nullptr;
+    }
+    return ptr;
+  }
+
+  template <typename Alignment = alignment<>>
+  static void deallocate(address addr, size_type size, [[maybe_unused]] Alignment alignment = {})
+  {
+    ouly::detail::vm_release(addr, size, page_mode);
+  }
+
+  static constexpr auto null() -> void*
+  {
+    return nullptr;
+  }
+
+  constexpr auto operator==(vm_allocator const& /*unused*/) const -> bool
+  {
+    return true;
+  }
+
+  constexpr auto operator!=(vm_allocator const& /*unused*/) const -> bool
+  {
+    return false;
+  }
+};
+
+} // namespace ouly
@@ -90,14 +90,29 @@ public:
   }
 
   /**
-   * @brief Returns result after waiting for the task to finish, with a non-blocking event, that tries to do work when
-   * this coro is not available
+   * @brief Returns result after waiting for the task to finish. The worker executes other work of the scheduler while
+   * the task is not done, and parks once there is nothing left to do. It is woken when the task completes.
    */
   auto sync_wait_result(worker_id worker, scheduler& s) noexcept -> R
   {
-    busywork_event event;
+    busywork_event event(worker, s);
     ouly::detail::wait(&event, this);
-    event.wait(worker, s);
+    event.wait();
+    if constexpr (!std::is_same_v<R, void>)
+    {
+      return coro_.promise().result();
+    }
+  }
+
+  /**
+   * @brief Returns result after waiting for the task to finish. If the calling thread is a worker of the scheduler it
+   * helps execute work while waiting, otherwise it parks until the task completes.
+   */
+  auto sync_wait_result(scheduler& s) noexcept -> R
+  {
+    busywork_event event(s);
+    ouly::detail::wait(&event, this);
+    event.wait();
     if constexpr (!std::is_same_v<R, void>)
     {
       return coro_.promise().result();
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "ouly/scheduler/spin_lock.hpp"
+#include "ouly/utility/config.hpp"
+#include "ouly/utility/tagged_ptr.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ouly::detail
+{
+
+/**
+ * @brief Intrusive multi producer, single consumer queue.
+ *
+ * Node must expose a `std::atomic<Node*> next_` member. Push is wait-free, a single exchange and store. Pop must only be
+ * called by one consumer at a time, it returns nullptr when the queue is empty or when a producer is half way through a
+ * push, in which case the item becomes visible on a later pop.
+ */
+template <typename Node>
+class mpsc_queue
+{
+public:
+  mpsc_queue() noexcept : head_(&stub_), tail_(&stub_) {}
+  mpsc_queue(mpsc_queue const&)                    = delete;
+  mpsc_queue(mpsc_queue&&)                         = delete;
+  auto operator=(mpsc_queue const&) -> mpsc_queue& = delete;
+  auto operator=(mpsc_queue&&) -> mpsc_queue&      = delete;
+  ~mpsc_queue() noexcept                           = default;
+
+  void push(Node* node) noexcept
+  {
+    node->next_.store(nullptr, std::memory_order_relaxed);
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next_.store(node, std::memory_order_release);
+  }
+
+  auto pop() noexcept -> Node*
+  {
+    Node* tail = tail_;
+    Node* next = tail->next_.load(std::memory_order_acquire);
+    if (tail == &stub_)
+    {
+      if (next == nullptr)
+      {
+        return nullptr;
+      }
+      tail_ = next;
+      tail  = next;
+      next  = next->next_.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr)
+    {
+      tail_ = next;
+      return tail;
+    }
+
+    if (tail != head_.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+
+    push(&stub_);
+    next = tail->next_.load(std::memory_order_acquire);
+    if (next != nullptr)
+    {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+private:
+  alignas(cache_line_size) std::atomic<Node*> head_;
+  alignas(cache_line_size) Node* tail_;
+  Node stub_;
+};
+
+/**
+ * @brief Lock-free free list of nodes, with chunked growth behind a rarely taken lock.
+ *
+ * Node must expose a `std::atomic<Node*> next_` member. Nodes are never returned to the system until the pool is
+ * destroyed, which keeps a concurrent pop that reads a recycled node's link safe, the tag on the head protects against
+ * ABA.
+ */
+template <typename Node, uint32_t ChunkSize = 256>
+class node_pool
+{
+  using head_ptr = ouly::tagged_ptr<Node>;
+
+public:
+  node_pool() noexcept                           = default;
+  node_pool(node_pool const&)                    = delete;
+  node_pool(node_pool&&)                         = delete;
+  auto operator=(node_pool const&) -> node_pool& = delete;
+  auto operator=(node_pool&&) -> node_pool&      = delete;
+  ~node_pool() noexcept                          = default;
+
+  auto acquire() -> Node*
+  {
+    auto head = free_.load(std::memory_order_acquire);
+    while (head.get_ptr() != nullptr)
+    {
+      auto next = head_ptr(head.get_ptr()->next_.load(std::memory_order_relaxed), head.get_next_tag());
+      if (free_.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+      {
+        return head.get_ptr();
+      }
+    }
+    return grow();
+  }
+
+  void release(Node* node) noexcept
+  {
+    release(node, node);
+  }
+
+  /**
+   * @brief Releases a chain of nodes linked through next_, from first to last
+   */
+  void release(Node* first, Node* last) noexcept
+  {
+    auto head = free_.load(std::memory_order_relaxed);
+    while (true)
+    {
+      last->next_.store(head.get_ptr(), std::memory_order_relaxed);
+      if (free_.compare_exchange_weak(head, head_ptr(first, head.get_next_tag()), std::memory_order_release,
+                                      std::memory_order_relaxed))
+      {
+        return;
+      }
+    }
+  }
+
+private:
+  auto grow() -> Node*
+  {
+    auto  lck   = std::scoped_lock(grow_lock_);
+    auto& chunk = chunks_.emplace_back(std::make_unique<Node[]>(ChunkSize));
+    for (uint32_t i = 1; i < ChunkSize - 1; ++i)
+    {
+      chunk[i].next_.store(&chunk[i + 1], std::memory_order_relaxed);
+    }
+    if constexpr (ChunkSize > 1)
+    {
+      release(&chunk[1], &chunk[ChunkSize - 1]);
+    }
+    return &chunk[0];
+  }
+
+  std::atomic<head_ptr>                free_ = head_ptr(nullptr, 0);
+  ouly::spin_lock                      grow_lock_;
+  std::vector<std::unique_ptr<Node[]>> chunks_;
+};
+
+} // namespace ouly::detail
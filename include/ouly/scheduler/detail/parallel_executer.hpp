@@ -64,6 +64,12 @@ concept HasParallelExecutionThreshold = requires {
   { T::parallel_execution_threshold } -> std::convertible_to<uint32_t>;
 };
 
+// Concept to check if a type has a static 'tuner' used for adaptive batch sizes
+template <typename T>
+concept HasGrainTuner = requires {
+  { T::tuner } -> std::same_as<grain_tuner&>;
+};
+
 template <typename T>
 struct fixed_batch_size_t
 {
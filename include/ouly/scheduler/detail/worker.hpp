@@ -4,10 +4,12 @@
 
 #include "ouly/allocators/default_allocator.hpp"
 #include "ouly/containers/basic_queue.hpp"
+#include "ouly/scheduler/detail/mpsc_queue.hpp"
 #include "ouly/scheduler/spin_lock.hpp"
 #include "ouly/scheduler/task.hpp"
 #include "ouly/scheduler/worker_context.hpp"
 #include "ouly/utility/tagged_ptr.hpp"
+#include <array>
 #include <cstdint>
 #include <limits>
 #include <mutex>
@@ -19,6 +21,8 @@ namespace ouly::detail
 
 static constexpr uint32_t max_worker_groups   = 32;
 static constexpr uint32_t max_local_work_item = 32; // 2 cache lines
+static constexpr uint32_t max_injection_batch = 32;
+static constexpr uint32_t max_spawn_depth     = 256;
 
 using work_item = task_delegate;
 
@@ -31,18 +35,43 @@ struct work_queue_traits
 using work_queue       = ouly::basic_queue<work_item, work_queue_traits>;
 using async_work_queue = std::pair<ouly::spin_lock, work_queue>;
 
+struct injection_node
+{
+  std::atomic<injection_node*> next_ = nullptr;
+  work_item                    work_;
+};
+
+using injection_node_pool = node_pool<injection_node>;
+
+/**
+ * @brief Submissions from threads outside a workgroup, drained in batches by the group's workers
+ */
+struct injection_queue
+{
+  mpsc_queue<injection_node> queue_;
+  // Items pushed but not yet drained
+  alignas(cache_line_size) std::atomic_uint32_t pending_ = 0;
+  // Held by the worker draining the queue
+  ouly::spin_lock consumer_;
+};
+
 struct workgroup
 {
   // Global queues, one per thread group
   std::unique_ptr<ouly::detail::async_work_queue[]> work_queues_;
-  uint32_t                                          thread_count_     = 0;
-  uint32_t                                          start_thread_idx_ = 0;
-  uint32_t                                          push_offset_      = 0;
-  uint32_t                                          priority_         = 0;
+  // Submissions from outside the group
+  std::unique_ptr<ouly::detail::injection_queue> injection_;
+  // Queue visiting order per member, a row of thread_count_ queue indices starting with the member's own queue,
+  // followed by its SMT siblings, workers sharing its cache, and the rest of the group
+  std::unique_ptr<uint32_t[]>                    steal_order_;
+  uint32_t                                       thread_count_     = 0;
+  uint32_t                                       start_thread_idx_ = 0;
+  uint32_t                                       priority_         = 0;
 
   auto create_group(uint32_t start, uint32_t count, uint32_t priority) noexcept -> uint32_t
   {
     work_queues_      = std::make_unique<ouly::detail::async_work_queue[]>(count);
+    injection_        = std::make_unique<ouly::detail::injection_queue>();
     thread_count_     = count;
     start_thread_idx_ = start;
     this->priority_   = priority;
@@ -88,12 +117,35 @@ struct group_range
   }
 };
 
+/**
+ * @brief Continuations of coroutines that spawned a child on this worker. The owner pushes and pops at the bottom in
+ * stack order, thieves take the oldest continuation from the top.
+ */
+struct continuation_deque
+{
+  struct entry
+  {
+    void*        address_ = nullptr;
+    workgroup_id group_;
+  };
+
+  ouly::spin_lock lock_;
+  // Monotonic positions, modified under lock_, read without it to skip empty deques
+  std::atomic_uint32_t               top_    = 0;
+  std::atomic_uint32_t               bottom_ = 0;
+  std::array<entry, max_spawn_depth> entries_;
+};
+
 struct worker
 {
   // Context per work group
   std::unique_ptr<worker_context[]> contexts_;
   // Worker specific item
   async_work_queue exlusive_items_;
+  // Stealable continuations of spawning coroutines
+  continuation_deque continuations_;
+  // Scratch memory of tasks running on this worker, only touched by the worker thread
+  mutable scratch_arena scratch_;
   // worker id
   worker_id id_;
   // quit event
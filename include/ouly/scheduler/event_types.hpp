@@ -3,6 +3,7 @@
 
 #include "ouly/scheduler/worker_context.hpp"
 #include "ouly/utility/config.hpp"
+#include <atomic>
 #include <semaphore>
 
 namespace ouly
@@ -30,21 +31,54 @@ private:
 };
 
 class scheduler;
+/**
+ * @brief An event that lets the waiter help the scheduler instead of blocking, without burning a core.
+ *
+ * A waiter that is a worker of the scheduler executes pending work while the event is not set, and parks on its own
+ * worker wake event once it runs out of work. Any other thread parks on the event flag, which is a futex wait where the
+ * platform provides one. notify() wakes the waiter directly, so it resumes as soon as the event is set. An external
+ * waiter only returns once notify() no longer touches the event, so the event can live on the waiter's stack.
+ */
 class busywork_event
 {
 public:
-  busywork_event(bool set) noexcept : semaphore_(static_cast<std::ptrdiff_t>(set)) {}
-  busywork_event() noexcept : semaphore_(0) {}
+  busywork_event(worker_id worker, scheduler& s) noexcept : owner_(&s), worker_(worker) {}
+  /**
+   * @brief Waits as the calling thread's worker in s, or as an external thread if it is not a worker of s
+   */
+  OULY_API explicit busywork_event(scheduler& s) noexcept;
+  /**
+   * @brief An event not bound to a scheduler, notify() cannot wake a parked worker so wait(worker, s) must be used
+   */
+  [[deprecated("Construct the event with the scheduler and use wait()")]] busywork_event(bool set) noexcept
+      : worker_(external_worker_id), set_(set), notified_(set)
+  {}
+  [[deprecated("Construct the event with the scheduler and use wait()")]] busywork_event() noexcept
+      : worker_(external_worker_id)
+  {}
+  busywork_event(busywork_event const&)                    = delete;
+  busywork_event(busywork_event&&)                         = delete;
+  auto operator=(busywork_event const&) -> busywork_event& = delete;
+  auto operator=(busywork_event&&) -> busywork_event&      = delete;
+  ~busywork_event() noexcept                               = default;
 
-  OULY_API void wait(worker_id worker, scheduler& s);
+  OULY_API void wait() noexcept;
+  OULY_API void notify() noexcept;
 
-  void notify()
-  {
-    semaphore_.release();
-  }
+  /**
+   * @brief Waits on an event that is not bound to a scheduler. The worker executes work of s while there is some, and
+   * yields when there is none, as notify() does not know which worker to wake.
+   */
+  [[deprecated("Construct the event with the scheduler and use wait()")]] OULY_API void wait(worker_id worker,
+                                                                                             scheduler& s) noexcept;
 
 private:
-  std::binary_semaphore semaphore_;
+  void wait_notified() const noexcept;
+
+  scheduler*       owner_ = nullptr;
+  worker_id        worker_;
+  std::atomic_bool set_      = false;
+  std::atomic_bool notified_ = false;
 };
 
 } // namespace ouly
@@ -2,10 +2,12 @@
 #pragma once
 
 #include "ouly/scheduler/detail/parallel_executer.hpp"
+#include "ouly/utility/blocked_range.hpp"
 #include "ouly/utility/integer_range.hpp"
 #include "ouly/utility/type_traits.hpp"
 #include <functional>
 #include <latch>
+#include <tuple>
 #include <type_traits>
 
 namespace ouly
@@ -25,6 +27,7 @@ namespace ouly
  *   - batches_per_worker: Controls granularity of work distribution
  *   - parallel_execution_threshold: Minimum task count for parallel execution
  *   - fixed_batch_size: Optional override for batch size
+ *   - tuner: Optional static grain_tuner, enables batch sizes measured at runtime (see adaptive_task_traits)
  *
  * - parallel_for: Main interface for parallel execution
  *   Supports two types of lambda functions:
@@ -134,9 +137,59 @@ void launch_parallel_tasks(L& lambda, auto range, uint32_t work_count, uint32_t
   pfor_instance.counter_.wait();
 }
 
+template <typename L>
+void launch_adaptive_tasks(L& lambda, auto range, uint32_t count, grain_tuner& tuner,
+                           worker_context const& this_context)
+{
+  using iterator_t                 = decltype(std::begin(range));
+  constexpr bool is_range_executor = ouly::detail::RangeExcuter<L, iterator_t>;
+
+  auto timed_executor = [&lambda, &tuner](iterator_t first, iterator_t last, worker_context const& wc)
+  {
+    auto start = tsc_clock::now();
+    if constexpr (is_range_executor)
+    {
+      lambda(first, last, wc);
+    }
+    else
+    {
+      for (auto it = first; it != last; ++it)
+      {
+        if constexpr (std::is_integral_v<std::decay_t<decltype(it)>>)
+        {
+          lambda(it, wc);
+        }
+        else
+        {
+          lambda(*it, wc);
+        }
+      }
+    }
+    tuner.record(static_cast<uint32_t>(last - first), tsc_clock::now() - start);
+  };
+
+  auto batch_size =
+   tuner.get_batch_size(count, this_context.get_scheduler().get_worker_count(this_context.get_workgroup()));
+  if (batch_size >= count)
+  {
+    timed_executor(std::begin(range), std::end(range), this_context);
+  }
+  else
+  {
+    launch_parallel_tasks(timed_executor, range, (count + batch_size - 1) / batch_size, batch_size, count,
+                          this_context);
+  }
+}
+
 template <typename L, typename FwIt, typename TaskTr = default_task_traits>
 void parallel_for(L lambda, FwIt range, worker_context const& this_context, TaskTr /*unused*/ = {})
 {
+  if constexpr (ouly::detail::HasGrainTuner<TaskTr>)
+  {
+    launch_adaptive_tasks(lambda, range, ouly::detail::it_size_type<FwIt>::size(range), TaskTr::tuner, this_context);
+    return;
+  }
+
   using iterator_t                 = decltype(std::begin(range));
   constexpr bool is_range_executor = ouly::detail::RangeExcuter<L, iterator_t>;
   using it_helper                  = ouly::detail::it_size_type<FwIt>;
@@ -201,6 +254,68 @@ void parallel_for(L lambda, FwIt range, worker_context const& this_context, Task
   }
 }
 
+/**
+ * @brief Executes a lambda over the tiles of a blocked range.
+ *
+ * The lambda receives the bounds of one tile per dimension:
+ * ```cpp
+ *   lambda(integer_range<I> x, integer_range<I> y, ouly::worker_context const& context);
+ *   lambda(integer_range<I> x, integer_range<I> y, integer_range<I> z, ouly::worker_context const& context);
+ * ```
+ * Tiles are enumerated in the order selected by the range and each task receives a contiguous run of that sequence,
+ * so with morton or hilbert order every worker processes a spatially compact group of tiles. The task traits are
+ * applied to the tile count: `batches_per_worker` controls how many runs are dispatched per worker,
+ * `fixed_batch_size` sets the number of tiles per run and `parallel_execution_threshold` is the minimum number of tiles
+ * for parallel execution.
+ */
+template <typename L, typename I, uint32_t Dim, typename TaskTr = default_task_traits>
+void parallel_for(L lambda, basic_blocked_range<I, Dim> const& range, worker_context const& this_context,
+                  TaskTr /*unused*/ = {})
+{
+  using size_type = uint32_t;
+  using traits    = ouly::detail::final_task_traits<TaskTr>;
+
+  auto tile_executor = [&range, &lambda](size_type first, size_type last, worker_context const& wc)
+  {
+    range.for_each_tile(first, last,
+                        [&](auto const& tile)
+                        {
+                          std::apply(
+                           [&](auto const&... bounds)
+                           {
+                             lambda(bounds..., wc);
+                           },
+                           tile);
+                        });
+  };
+
+  size_type const count      = range.get_sequence_size();
+  size_type const tile_count = range.get_tile_count();
+
+  constexpr uint32_t min_batches_per_worker = 1;
+  size_type const    work_count             = [&]()
+  {
+    if (traits::fixed_batch_size)
+    {
+      return (count + traits::fixed_batch_size - 1) / traits::fixed_batch_size;
+    }
+    return std::min(count, std::max(min_batches_per_worker, traits::batches_per_worker) *
+                            this_context.get_scheduler().get_worker_count(this_context.get_workgroup()));
+  }();
+
+  if (tile_count <= traits::parallel_execution_threshold || work_count <= 1)
+  {
+    tile_executor(0, count, this_context);
+  }
+  else
+  {
+    size_type const batch_size =
+     traits::fixed_batch_size ? traits::fixed_batch_size : (count + work_count - 1) / work_count;
+    launch_parallel_tasks(tile_executor, integer_range<size_type>(0, count), (count + batch_size - 1) / batch_size,
+                          batch_size, count, this_context);
+  }
+}
+
 /**
  *
  * Call this method with either of these lambda functions:
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "ouly/allocators/default_allocator.hpp"
+#include "ouly/scheduler/scheduler.hpp"
+#include "ouly/utility/config.hpp"
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+namespace ouly
+{
+
+/**
+ * @brief Per worker storage for accumulating partial results without contention.
+ *
+ * Holds one instance of T per scheduler worker, indexed by the worker id. Instances are constructed lazily on first
+ * access from their worker, so workers that never touch the storage cost a single pointer. Every instance is placed in
+ * its own cache line aligned block, so writes from different workers never share a cache line.
+ *
+ * @code
+ * ouly::per_worker<std::array<uint32_t, 256>> histogram(scheduler);
+ * ouly::parallel_for(
+ *  [&](uint8_t value, ouly::worker_context const& ctx)
+ *  {
+ *    histogram.local(ctx)[value]++;
+ *  },
+ *  std::span(pixels), ouly::default_workgroup_id);
+ * auto total = histogram.combine(
+ *  [](auto a, auto const& b)
+ *  {
+ *    for (size_t i = 0; i < a.size(); ++i)
+ *      a[i] += b[i];
+ *    return a;
+ *  });
+ * @endcode
+ *
+ * @note local() is only safe to call from the worker that owns the slot, combine(), for_each() and clear() must not run
+ * concurrently with workers writing to the storage.
+ */
+template <typename T, typename Allocator = ouly::default_allocator<>>
+class per_worker : Allocator
+{
+  static constexpr std::size_t slot_alignment = std::max<std::size_t>(alignof(T), ouly::detail::cache_line_size);
+  static constexpr std::size_t slot_size      = ((sizeof(T) + slot_alignment - 1) / slot_alignment) * slot_alignment;
+
+public:
+  using value_type = T;
+
+  per_worker() noexcept = default;
+  explicit per_worker(uint32_t worker_count) : slots_(std::make_unique<T*[]>(worker_count)), count_(worker_count) {}
+  explicit per_worker(scheduler const& s) : per_worker(s.get_worker_count()) {}
+  per_worker(per_worker const&) = delete;
+  per_worker(per_worker&& other) noexcept
+      : Allocator(std::move(static_cast<Allocator&>(other))), slots_(std::move(other.slots_)),
+        count_(std::exchange(other.count_, 0))
+  {}
+  ~per_worker() noexcept
+  {
+    clear();
+  }
+
+  auto operator=(per_worker const&) -> per_worker& = delete;
+  auto operator=(per_worker&& other) noexcept -> per_worker&
+  {
+    if (this != &other)
+    {
+      clear();
+      static_cast<Allocator&>(*this) = std::move(static_cast<Allocator&>(other));
+      slots_                         = std::move(other.slots_);
+      count_                         = std::exchange(other.count_, 0);
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Returns the instance owned by the worker, constructing it with args on first access.
+   */
+  template <typename... Args>
+  auto local(worker_id worker, Args&&... args) -> T&
+  {
+    assert(worker.get_index() < count_ && "Worker index out of range, was the storage sized for this scheduler?");
+    auto*& slot = slots_[worker.get_index()];
+    if (slot == nullptr) [[unlikely]]
+    {
+      slot = std::construct_at(static_cast<T*>(Allocator::allocate(slot_size, alignment<slot_alignment>())),
+                               std::forward<Args>(args)...);
+    }
+    return *slot;
+  }
+
+  template <typename... Args>
+  auto local(worker_context const& ctx, Args&&... args) -> T&
+  {
+    return local(ctx.get_worker(), std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief Returns the instance owned by the worker if it was constructed, nullptr otherwise
+   */
+  [[nodiscard]] auto get(worker_id worker) const noexcept -> T*
+  {
+    return worker.get_index() < count_ ? slots_[worker.get_index()] : nullptr;
+  }
+
+  /**
+   * @brief Calls fn(T&) on every constructed instance
+   */
+  template <typename Fn>
+  void for_each(Fn&& fn)
+  {
+    for (uint32_t i = 0; i < count_; ++i)
+    {
+      if (slots_[i] != nullptr)
+      {
+        fn(*slots_[i]);
+      }
+    }
+  }
+
+  template <typename Fn>
+  void for_each(Fn&& fn) const
+  {
+    for (uint32_t i = 0; i < count_; ++i)
+    {
+      if (slots_[i] != nullptr)
+      {
+        fn(std::as_const(*slots_[i]));
+      }
+    }
+  }
+
+  /**
+   * @brief Folds all constructed instances using result = op(result, instance), starting from init.
+   */
+  template <typename R, typename Op>
+  [[nodiscard]] auto combine(R init, Op&& op) const -> R
+  {
+    for_each(
+     [&](T const& value)
+     {
+       init = op(std::move(init), value);
+     });
+    return init;
+  }
+
+  /**
+   * @brief Folds all constructed instances using op, returns a value initialized T if none was constructed.
+   */
+  template <typename Op>
+  [[nodiscard]] auto combine(Op&& op) const -> T
+  {
+    T*       first = nullptr;
+    uint32_t i     = 0;
+    for (; i < count_ && first == nullptr; ++i)
+    {
+      first = slots_[i];
+    }
+    if (first == nullptr)
+    {
+      return T{};
+    }
+    T result = *first;
+    for (; i < count_; ++i)
+    {
+      if (slots_[i] != nullptr)
+      {
+        result = op(std::move(result), std::as_const(*slots_[i]));
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @brief Destroys all constructed instances, they will be constructed again on next access
+   */
+  void clear() noexcept
+  {
+    for (uint32_t i = 0; i < count_; ++i)
+    {
+      if (slots_[i] != nullptr)
+      {
+        std::destroy_at(slots_[i]);
+        Allocator::deallocate(slots_[i], slot_size, alignment<slot_alignment>());
+        slots_[i] = nullptr;
+      }
+    }
+  }
+
+  /**
+   * @brief Number of slots, equal to the worker count of the scheduler
+   */
+  [[nodiscard]] auto size() const noexcept -> uint32_t
+  {
+    return count_;
+  }
+
+private:
+  std::unique_ptr<T*[]> slots_;
+  uint32_t              count_ = 0;
+};
+
+} // namespace ouly
@@ -62,7 +62,10 @@ static constexpr uint32_t default_logical_task_divisior = 64;
  *
  * @note The scheduler must be started with begin_execution() before submitting tasks
  * @note Work group creation is frozen after begin_execution() is called
- * @note Only one scheduler should be active at a time, use take_ownership() if multiple exist
+ * @note Multiple schedulers can be active at the same time, each keeps its own thread local binding. A thread may be
+ * the main thread of more than one scheduler, worker_context::get(group) resolves to the scheduler it was most
+ * recently bound to, use worker_context::get(scheduler, group) or take_ownership() to be explicit. Work is passed
+ * between schedulers with async(scheduler&, ...) which always uses the lock-free injection queue.
  */
 class scheduler
 {
@@ -304,9 +307,50 @@ public:
 
   /**
    * @brief Submit a work for execution
+   *
+   * Work is handed directly to a sleeping worker of the group when there is one. Otherwise, if src belongs to the
+   * group, the work is pushed into src's own queue where other workers of the group can steal it. Submissions from
+   * outside the group go into the group's lock-free injection queue, which its workers drain in batches, so external
+   * producers never spin or touch worker queues.
    */
   OULY_API void submit(worker_id src, workgroup_id dst, ouly::detail::work_item work);
 
+  /**
+   * @brief Submits a coroutine task with an affinity hint, see submit(worker_id, affinity_hint, workgroup_id, work_item)
+   */
+  template <CoroutineTask C>
+  void submit(worker_id src, affinity_hint hint, workgroup_id group, C const& task_obj) noexcept
+  {
+    submit(src, hint, group,
+           ouly::detail::work_item::pbind(
+            [address = task_obj.address()](worker_context const&)
+            {
+              std::coroutine_handle<>::from_address(address).resume();
+            },
+            group));
+  }
+
+  /**
+   * @brief Submits a lambda with an affinity hint, see submit(worker_id, affinity_hint, workgroup_id, work_item)
+   */
+  template <typename Lambda>
+    requires(ouly::detail::Callable<Lambda, ouly::worker_context const&>)
+  void submit(worker_id src, affinity_hint hint, workgroup_id group, Lambda&& data) noexcept
+  {
+    submit(src, hint, group, ouly::detail::work_item::pbind(std::forward<Lambda>(data), group));
+  }
+
+  /**
+   * @brief Submit a work for execution close to a preferred worker
+   *
+   * With affinity_scope::worker the work is handed to the preferred worker if it is sleeping, otherwise queued on it.
+   * With affinity_scope::shared_cache a sleeping worker of the group that shares the last level cache with the
+   * preferred worker is woken for it first. Queued work can still be stolen, thieves look at their SMT siblings first,
+   * then at workers sharing their cache, then at the rest of the group. If the preferred worker is not part of the
+   * group the hint is ignored.
+   */
+  OULY_API void submit(worker_id src, affinity_hint hint, workgroup_id dst, ouly::detail::work_item work);
+
   /**
    * @brief Begin scheduler execution, group creation is frozen after this call.
    * @param entry An entry function can be provided that will be executed on all worker threads upon entry.
@@ -318,6 +362,13 @@ public:
    */
   OULY_API void end_execution();
 
+  /**
+   * @brief Describe where a worker thread runs, so that stealing and affinity hints follow the cache topology. Must
+   * be called before begin_execution(), pin the worker thread accordingly in the entry function. Workers without a
+   * description are treated as separate cores sharing one cache.
+   */
+  OULY_API void set_worker_topology(worker_id worker, worker_topology topology);
+
   /**
    * @brief Get worker count in the scheduler
    */
@@ -369,18 +420,64 @@ public:
   }
 
   /**
-   * @brief If multiple schedulers are active, this function should be called from main thread before using the
-   * scheduler
+   * @brief Get the scratch arena of a worker, see worker_context::scratch()
+   */
+  auto get_scratch_arena(worker_id worker) const noexcept -> scratch_arena&
+  {
+    return workers_[worker.get_index()].scratch_;
+  }
+
+  /**
+   * @brief Makes this scheduler the one worker_context::get(group) and worker_id::get() resolve to on the calling
+   * thread, the calling thread becomes the main worker of this scheduler
    */
   OULY_API void take_ownership() noexcept;
-  OULY_API void busy_work(worker_id /*thread*/) noexcept;
+
+  /**
+   * @brief Makes the continuation of a spawning coroutine stealable by other workers of group, used by spawn().
+   * @return false if the worker's continuation deque is full, the caller should not make the continuation stealable
+   */
+  OULY_API auto push_continuation(worker_id worker, workgroup_id group, std::coroutine_handle<> continuation) noexcept
+   -> bool;
+
+  /**
+   * @brief Takes back the most recent continuation pushed by worker, used by spawn().
+   * @return false if the continuation was stolen, it will be resumed by the thief
+   */
+  OULY_API auto pop_continuation(worker_id worker, std::coroutine_handle<> continuation) noexcept -> bool;
+
+  /**
+   * @brief Returns the worker id of the calling thread in this scheduler, external_worker_id if the calling thread is
+   * not a worker of this scheduler
+   */
+  [[nodiscard]] OULY_API auto get_local_worker() const noexcept -> worker_id;
+  /**
+   * @brief Executes one pending work item on the given worker
+   * @return false if there was no work to execute
+   */
+  OULY_API auto busy_work(worker_id /*thread*/) noexcept -> bool;
 
 private:
+  friend class busywork_event;
+
+  /**
+   * @brief Executes work on the given worker until done is set, parking the worker whenever it runs out of work
+   */
+  void        help_until(worker_id /*thread*/, std::atomic_bool const& /*done*/) noexcept;
   void        finish_pending_tasks() noexcept;
   inline void do_work(worker_id /*thread*/, ouly::detail::work_item& /*work*/) noexcept;
+  inline auto run_local_work(worker_id /*thread*/) noexcept -> bool;
   void        wake_up(worker_id /*thread*/) noexcept;
   void        run(worker_id /*thread*/);
   auto        get_work(worker_id /*thread*/) noexcept -> ouly::detail::work_item;
+  auto        drain_injection(worker_id /*thread*/, ouly::detail::workgroup& /*group*/) noexcept
+   -> ouly::detail::work_item;
+  void        wake_one(ouly::detail::workgroup const& /*group*/) noexcept;
+  void        build_steal_order(ouly::detail::workgroup& /*group*/) const;
+  auto        steal_continuation(worker_id /*thread*/, ouly::detail::workgroup const& /*group*/,
+                                 workgroup_id /*group_id*/) noexcept -> ouly::detail::work_item;
+  void        bind_thread(worker_id /*thread*/) noexcept;
+  void        unbind_thread() noexcept;
 
   auto work(worker_id /*thread*/) noexcept -> bool;
 
@@ -396,7 +493,13 @@ private:
   std::unique_ptr<std::atomic_bool[]>          wake_status_;
   std::unique_ptr<ouly::detail::wake_event[]>  wake_events_;
   std::vector<std::thread>                     threads_;
+  // Cpu placement of workers, used to order stealing
+  std::vector<worker_topology>                 topology_;
+  // Nodes for submissions into workgroup injection queues
+  ouly::detail::injection_node_pool injection_pool_;
 
+  // Identifies this execution session in thread local bindings, so a stale binding never matches a new scheduler
+  uint64_t         instance_id_  = 0;
   uint32_t         worker_count_ = 0;
   std::atomic_bool stop_         = false;
 };
@@ -478,4 +581,40 @@ void async(worker_context const& current, worker_id dst, workgroup_id submit_gro
   current.get_scheduler().submit<M>(current.get_worker(), dst, submit_group, std::forward<Args>(args)...);
 }
 
+/**
+ * @brief Asynchronously submits a task close to a preferred worker, see @ref affinity_hint
+ *
+ * @code
+ * // Per frame job touching the same chunk of data keeps running on the same worker
+ * ouly::async(ctx, ouly::prefer_worker(ouly::worker_id(chunk % workers)), group, update_chunk);
+ * @endcode
+ */
+template <typename... Args>
+void async(worker_context const& current, affinity_hint hint, workgroup_id submit_group, Args&&... args)
+{
+  current.get_scheduler().submit(current.get_worker(), hint, submit_group, std::forward<Args>(args)...);
+}
+
+/**
+ * @brief Submits a task to a workgroup of a scheduler from a thread that is not one of its workers.
+ *
+ * Use this to pass work between schedulers or from foreign threads. The task is pushed into the workgroup's lock-free
+ * injection queue, no worker queue lock of the target scheduler is taken.
+ *
+ * @param target The scheduler that will execute the task
+ * @param submit_group The workgroup of target where the task should be scheduled
+ * @param args Arguments to be forwarded to the task
+ */
+template <typename... Args>
+void async(scheduler& target, workgroup_id submit_group, Args&&... args)
+{
+  target.submit(external_worker_id, submit_group, std::forward<Args>(args)...);
+}
+
+template <auto M, typename... Args>
+void async(scheduler& target, workgroup_id submit_group, Args&&... args)
+{
+  target.submit<M>(external_worker_id, submit_group, std::forward<Args>(args)...);
+}
+
 } // namespace ouly
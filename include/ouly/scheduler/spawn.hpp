@@ -0,0 +1,83 @@
+#pragma once
+
+#include "ouly/scheduler/scheduler.hpp"
+#include <coroutine>
+
+namespace ouly
+{
+
+/**
+ * @brief Awaiter returned by @ref spawn, runs the child immediately and makes the parent's continuation stealable.
+ */
+template <CoroutineTask Task>
+class spawn_awaiter
+{
+public:
+  spawn_awaiter(scheduler& s, workgroup_id group, Task& child) noexcept : owner_(&s), child_(&child), group_(group) {}
+
+  [[nodiscard]] static auto await_ready() noexcept -> bool
+  {
+    return false;
+  }
+
+  auto await_suspend(std::coroutine_handle<> parent) noexcept -> bool
+  {
+    // Once the continuation is pushed a thief may resume the parent and destroy this awaiter, only locals are used
+    // after that point
+    auto& s      = *owner_;
+    auto  child  = std::coroutine_handle<>::from_address(child_->address());
+    auto  worker = s.get_local_worker();
+    if (!worker || !s.push_continuation(worker, group_, parent))
+    {
+      child.resume();
+      return false;
+    }
+    child.resume();
+    return !s.pop_continuation(worker, parent);
+  }
+
+  void await_resume() noexcept {}
+
+private:
+  scheduler*   owner_;
+  Task*        child_;
+  workgroup_id group_;
+};
+
+/**
+ * @brief Work-first spawn of a child task from a coroutine running on a scheduler worker.
+ *
+ * The child starts running on the current worker right away, while the continuation of the awaiting coroutine is
+ * pushed on the worker's deque where idle workers of the group can steal it. When the child finishes or suspends and
+ * the continuation was not stolen, the parent continues on the same worker, so without thieves the execution order is
+ * the serial one. The parent joins the child with `co_await child`, which does not suspend if the child is done.
+ *
+ * @code
+ * ouly::co_task<uint64_t> fib(ouly::scheduler& s, uint32_t n)
+ * {
+ *   if (n < 2)
+ *     co_return n;
+ *   auto a = fib(s, n - 1);
+ *   auto b = fib(s, n - 2);
+ *   co_await ouly::spawn(s, ouly::default_workgroup_id, a);
+ *   co_await ouly::spawn(s, ouly::default_workgroup_id, b);
+ *   co_return co_await a + co_await b;
+ * }
+ * @endcode
+ *
+ * @note Continuations are kept in a bounded deque per worker, when it is full or the caller is not a worker of s the
+ * child is simply run inline. The child task object must outlive its execution, keep it alive until it is joined.
+ */
+template <CoroutineTask Task>
+auto spawn(scheduler& s, workgroup_id group, Task& child) noexcept -> spawn_awaiter<Task>
+{
+  return spawn_awaiter<Task>(s, group, child);
+}
+
+template <CoroutineTask Task>
+auto spawn(worker_context const& ctx, Task& child) noexcept -> spawn_awaiter<Task>
+{
+  return spawn_awaiter<Task>(ctx.get_scheduler(), ctx.get_workgroup(), child);
+}
+
+} // namespace ouly
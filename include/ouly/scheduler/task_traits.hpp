@@ -1,3 +1,8 @@
+#pragma once
+
+#include "ouly/utility/tsc_clock.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 
 namespace ouly
@@ -20,4 +25,121 @@ struct default_task_traits
    */
   static constexpr uint32_t fixed_batch_size = 0;
 };
-} // namespace ouly
\ No newline at end of file
+
+/**
+ * @brief Tuning state for adaptive parallel_for batch sizes.
+ *
+ * Every batch executed by an adaptive parallel_for is timed with @ref tsc_clock and folded into a running estimate of
+ * the cost per element. The batch size is then chosen so that a batch takes roughly the target duration, and when the
+ * whole loop is estimated to be cheaper than a few batches, it is executed serially on the calling worker instead.
+ *
+ * The state is meant to be a static object, one per call site, exposed through the task traits as `tuner`:
+ * @code
+ * struct particle_update_traits
+ * {
+ *   static inline ouly::grain_tuner tuner{30};
+ * };
+ * ouly::parallel_for(update, std::span(particles), ouly::default_workgroup_id, particle_update_traits{});
+ * @endcode
+ * or using @ref adaptive_task_traits with a unique tag type per call site.
+ * @note Updates from concurrent batches are relaxed, a lost sample only delays convergence.
+ */
+class grain_tuner
+{
+public:
+  static constexpr uint32_t default_target_us       = 30;
+  static constexpr uint32_t max_batches_per_worker  = 64;
+  static constexpr uint32_t serial_batch_multiplier = 2;
+
+  constexpr grain_tuner() noexcept = default;
+  constexpr explicit grain_tuner(uint32_t target_us) noexcept : target_us_(target_us) {}
+
+  /**
+   * @brief Returns the batch size to use for a loop of `count` elements executed on `workers` workers. A value equal
+   * to `count` means the loop should be executed serially.
+   */
+  [[nodiscard]] auto get_batch_size(uint32_t count, uint32_t workers) const noexcept -> uint32_t
+  {
+    constexpr uint32_t first_run_batches_per_worker = 4;
+
+    if (count == 0 || workers <= 1)
+    {
+      return std::max(count, 1U);
+    }
+
+    auto cost = cost_per_element_.load(std::memory_order_relaxed);
+    if (cost <= 0.0)
+    {
+      // Nothing measured yet, split evenly so the first run produces samples
+      return std::max(1U, count / (workers * first_run_batches_per_worker));
+    }
+
+    auto target = static_cast<double>(target_us_) * tsc_clock::ticks_per_us();
+    if (cost * static_cast<double>(count) <= target * serial_batch_multiplier)
+    {
+      return count;
+    }
+
+    auto batch     = static_cast<uint32_t>(std::clamp(target / cost, 1.0, static_cast<double>(count)));
+    auto min_batch = (count + (workers * max_batches_per_worker) - 1) / (workers * max_batches_per_worker);
+    return std::max(batch, min_batch);
+  }
+
+  /**
+   * @brief Records the execution time of a batch
+   */
+  void record(uint32_t elements, uint64_t ticks) noexcept
+  {
+    if (elements == 0)
+    {
+      return;
+    }
+    constexpr double smoothing = 0.25;
+
+    auto sample = static_cast<double>(ticks) / static_cast<double>(elements);
+    auto cost   = cost_per_element_.load(std::memory_order_relaxed);
+    cost_per_element_.store(cost <= 0.0 ? sample : cost + ((sample - cost) * smoothing), std::memory_order_relaxed);
+    sample_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Estimated cost of one element in microseconds, 0 if nothing was measured yet
+   */
+  [[nodiscard]] auto get_cost_per_element_us() const noexcept -> double
+  {
+    return cost_per_element_.load(std::memory_order_relaxed) / tsc_clock::ticks_per_us();
+  }
+
+  [[nodiscard]] auto get_sample_count() const noexcept -> uint64_t
+  {
+    return sample_count_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto get_target_us() const noexcept -> uint32_t
+  {
+    return target_us_;
+  }
+
+  void reset() noexcept
+  {
+    cost_per_element_.store(0.0, std::memory_order_relaxed);
+    sample_count_.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<double>   cost_per_element_ = 0.0;
+  std::atomic<uint64_t> sample_count_     = 0;
+  uint32_t              target_us_        = default_target_us;
+};
+
+/**
+ * @brief Task traits that enable adaptive batch sizes. Use a unique Tag per call site, so each loop converges to its
+ * own cost estimate.
+ */
+template <typename Tag, uint32_t TargetUs = grain_tuner::default_target_us>
+struct adaptive_task_traits : default_task_traits
+{
+  static inline grain_tuner tuner{TargetUs};
+};
+
+} // namespace ouly
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ouly/allocators/linear_stack_allocator.hpp"
 #include "ouly/utility/nullable_optional.hpp"
 #include <cassert>
 #include <compare>
@@ -34,10 +35,16 @@ public:
   }
 
   /**
-   * @brief Returns the worker id for the current thread
+   * @brief Returns the worker id for the current thread, in the scheduler this thread was most recently bound to
    */
   static auto get() noexcept -> worker_id const&;
 
+  /**
+   * @brief Returns the worker id of the current thread in the given scheduler, or external_worker_id if the thread is
+   * not one of its workers
+   */
+  static auto get(scheduler const& s) noexcept -> worker_id;
+
   auto operator<=>(worker_id const&) const noexcept = default;
 
 private:
@@ -45,6 +52,52 @@ private:
 };
 
 static constexpr worker_id main_worker_id = worker_id(0);
+/**
+ * @brief Source id for submissions from threads that are not workers of the target scheduler, including workers of
+ * another scheduler. Such submissions always go through the lock-free injection queue of the workgroup.
+ */
+static constexpr worker_id external_worker_id = worker_id(std::numeric_limits<uint32_t>::max());
+
+/**
+ * @brief Placement of a worker thread in the cpu topology. Workers with equal core_id_ are SMT siblings, workers with
+ * equal cache_id_ share the last level cache.
+ */
+struct worker_topology
+{
+  uint32_t core_id_  = std::numeric_limits<uint32_t>::max();
+  uint32_t cache_id_ = 0;
+};
+
+/**
+ * @brief How strictly a submission should follow its affinity hint
+ */
+enum class affinity_scope : uint8_t
+{
+  /** Queue the item on the preferred worker */
+  worker,
+  /** Run the item on any worker sharing the last level cache with the preferred worker */
+  shared_cache
+};
+
+/**
+ * @brief A hint for placing a submitted item close to the data it works on. Hints are best effort, the item is still
+ * subject to stealing, and a hint for a worker outside the submitted workgroup is ignored.
+ */
+struct affinity_hint
+{
+  worker_id      worker_;
+  affinity_scope scope_ = affinity_scope::worker;
+};
+
+constexpr auto prefer_worker(worker_id worker) noexcept -> affinity_hint
+{
+  return {.worker_ = worker, .scope_ = affinity_scope::worker};
+}
+
+constexpr auto prefer_shared_cache(worker_id worker) noexcept -> affinity_hint
+{
+  return {.worker_ = worker, .scope_ = affinity_scope::shared_cache};
+}
 
 /**
  * @brief A workgroup is a collection of workers where you can push tasks to be executed. A task have to be assigned
@@ -79,6 +132,11 @@ private:
 
 static constexpr workgroup_id default_workgroup_id = workgroup_id(0);
 
+/**
+ * @brief Stack of scratch memory owned by every worker, see worker_context::scratch()
+ */
+using scratch_arena = ouly::linear_stack_allocator<>;
+
 /**
  * @brief A worker context is a unique identifier that represents where a task can run, it stores the current
  * worker_id, and the workgroup for the current task.
@@ -131,10 +189,32 @@ public:
   }
 
   /**
-   * @brief returns the context on the current thread for a given worker group
+   * @brief Returns the scratch arena of the current worker, it is only used by tasks running on this worker
+   */
+  [[nodiscard]] auto get_scratch_arena() const noexcept -> scratch_arena&;
+
+  /**
+   * @brief Opens a scratch scope on the current worker. Memory allocated from the worker's scratch arena, directly or
+   * through a @ref scratch_allocator, is a pointer bump and is released all at once when the scope ends. Scopes nest,
+   * but must not be held across a suspension point of a coroutine, another task may use the worker's scratch meanwhile.
+   */
+  [[nodiscard]] auto scratch() const -> scratch_arena::scoped_rewind
+  {
+    return scratch_arena::scoped_rewind(get_scratch_arena());
+  }
+
+  /**
+   * @brief returns the context on the current thread for a given worker group, in the scheduler this thread was most
+   * recently bound to
    */
   static auto get(workgroup_id group) noexcept -> worker_context const&;
 
+  /**
+   * @brief returns the context on the current thread for a given worker group of the given scheduler, the current
+   * thread must be a worker of that scheduler
+   */
+  static auto get(scheduler& s, workgroup_id group) noexcept -> worker_context const&;
+
   auto operator<=>(worker_context const&) const noexcept = default;
 
 private:
@@ -148,6 +228,64 @@ private:
 
 using worker_context_opt = ouly::nullable_optional<worker_context>;
 
+/**
+ * @brief Allocator handle on the scratch arena of a worker, for temporary containers inside a scratch scope.
+ *
+ * The handle is a pointer, it can be copied freely and used as the allocator of ouly::vector or as the
+ * cfg::allocator_type of small_vector. A default constructed handle refers to the scratch arena of the calling worker.
+ * deallocate() does nothing, the memory comes back when the enclosing worker_context::scratch() scope ends, so
+ * containers using the handle must be destroyed before the scope.
+ *
+ * @code
+ * auto scope = ctx.scratch();
+ * ouly::vector<uint32_t, ouly::scratch_allocator> visible;
+ * ouly::small_vector<float, 16, ouly::config<ouly::cfg::allocator_type<ouly::scratch_allocator>>> weights;
+ * @endcode
+ */
+class scratch_allocator
+{
+public:
+  using tag       = linear_stack_allocator_tag;
+  using size_type = scratch_arena::size_type;
+  using address   = scratch_arena::address;
+
+  scratch_allocator() noexcept : arena_(local_arena()) {}
+  explicit scratch_allocator(worker_context const& ctx) noexcept : arena_(&ctx.get_scratch_arena()) {}
+  explicit scratch_allocator(scratch_arena& arena) noexcept : arena_(&arena) {}
+
+  constexpr static auto null() -> address
+  {
+    return scratch_arena::null();
+  }
+
+  template <typename Alignment = alignment<>>
+  [[nodiscard]] auto allocate(size_type size, Alignment align = {}) const -> address
+  {
+    assert(arena_ && "No scratch arena, the calling thread is not a scheduler worker");
+    return arena_->allocate(size, align);
+  }
+
+  template <typename Alignment = alignment<>>
+  void deallocate([[maybe_unused]] address data, [[maybe_unused]] size_type size,
+                  [[maybe_unused]] Alignment align = {}) const noexcept
+  {}
+
+  [[nodiscard]] auto get_arena() const noexcept -> scratch_arena*
+  {
+    return arena_;
+  }
+
+  auto operator==(scratch_allocator const&) const noexcept -> bool = default;
+
+private:
+  /**
+   * @brief Scratch arena of the worker the calling thread is bound to, nullptr if it is not bound to a scheduler
+   */
+  static auto local_arena() noexcept -> scratch_arena*;
+
+  scratch_arena* arena_ = nullptr;
+};
+
 /**
  * @brief A worker context descriptor for the scheduler system
  *
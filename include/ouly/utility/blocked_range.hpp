@@ -0,0 +1,321 @@
+#pragma once
+
+#include "ouly/utility/integer_range.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace ouly
+{
+
+/**
+ * @brief Order in which the tiles of a blocked range are enumerated.
+ *
+ * - row_major: x varies fastest, then y, then z.
+ * - morton: Z-order curve, tiles that are close in sequence are close in space.
+ * - hilbert: Hilbert curve, consecutive tiles are always neighbours. Only available for 2D ranges, 3D ranges fall back
+ *   to morton order.
+ */
+enum class tile_order : uint8_t
+{
+  row_major,
+  morton,
+  hilbert
+};
+
+/**
+ * @brief A multi-dimensional integer range split into fixed size tiles.
+ *
+ * The range is enumerated as a linear sequence of tiles in the selected @ref tile_order. Curve orders are computed over
+ * a power of two padded grid, so the sequence may contain holes which are skipped during enumeration. This allows
+ * decoding a tile from its sequence index in constant time, so that any sub-range of the sequence can be executed
+ * independently. Sequence indices are 32 bit, a curve order whose padded grid needs more indices falls back to a
+ * denser order, hilbert to morton and morton to row_major.
+ *
+ * @code
+ * auto range = ouly::blocked_range2d<uint32_t>({ouly::integer_range(0U, width), ouly::integer_range(0U, height)},
+ *                                              {64, 64}, ouly::tile_order::hilbert);
+ * ouly::parallel_for(
+ *  [&](ouly::integer_range<uint32_t> x, ouly::integer_range<uint32_t> y, ouly::worker_context const& ctx)
+ *  {
+ *    // process tile
+ *  },
+ *  range, ouly::default_workgroup_id);
+ * @endcode
+ */
+template <typename I, uint32_t Dim>
+class basic_blocked_range
+{
+  static_assert(Dim >= 1 && Dim <= 3, "Blocked range supports 1 to 3 dimensions");
+
+public:
+  using value_type  = I;
+  using range_type  = integer_range<I>;
+  using extent_type = std::array<range_type, Dim>;
+  using tile_size   = std::array<I, Dim>;
+  using tile_type   = std::array<range_type, Dim>;
+
+  static constexpr uint32_t dimensions = Dim;
+
+  constexpr basic_blocked_range() noexcept = default;
+  constexpr basic_blocked_range(extent_type extent, tile_size tile, tile_order order = tile_order::row_major) noexcept
+      : extent_(extent), tile_(tile), order_(order)
+  {
+    if constexpr (Dim != 2)
+    {
+      if (order_ == tile_order::hilbert)
+      {
+        order_ = tile_order::morton;
+      }
+    }
+
+    for (uint32_t d = 0; d < Dim; ++d)
+    {
+      assert(tile_[d] > 0 && "Tile size must be non-zero");
+      auto size      = static_cast<uint32_t>(extent_[d].size());
+      auto tile      = static_cast<uint32_t>(tile_[d]);
+      tile_count_[d] = (size + tile - 1) / tile;
+      bits_[d]       = static_cast<uint32_t>(std::bit_width(std::bit_ceil(tile_count_[d]) - 1U));
+    }
+
+    if constexpr (Dim == 2)
+    {
+      auto short_side = std::min(tile_count_[0], tile_count_[1]);
+      hilbert_side_   = std::bit_ceil(short_side);
+    }
+
+    constexpr uint64_t max_sequence = std::numeric_limits<uint32_t>::max();
+    if (order_ == tile_order::hilbert && sequence_size(order_) > max_sequence)
+    {
+      order_ = tile_order::morton;
+    }
+    if (order_ == tile_order::morton && sequence_size(order_) > max_sequence)
+    {
+      order_ = tile_order::row_major;
+    }
+    assert(sequence_size(order_) <= max_sequence && "Too many tiles for 32 bit sequence indices");
+  }
+
+  [[nodiscard]] constexpr auto get_extent() const noexcept -> extent_type const&
+  {
+    return extent_;
+  }
+
+  [[nodiscard]] constexpr auto get_tile_size() const noexcept -> tile_size const&
+  {
+    return tile_;
+  }
+
+  [[nodiscard]] constexpr auto get_order() const noexcept -> tile_order
+  {
+    return order_;
+  }
+
+  /**
+   * @brief Number of tiles along a given dimension
+   */
+  [[nodiscard]] constexpr auto get_tile_count(uint32_t dim) const noexcept -> uint32_t
+  {
+    return tile_count_[dim];
+  }
+
+  /**
+   * @brief Total number of valid tiles
+   */
+  [[nodiscard]] constexpr auto get_tile_count() const noexcept -> uint32_t
+  {
+    uint32_t count = 1;
+    for (auto c : tile_count_)
+    {
+      count *= c;
+    }
+    return count;
+  }
+
+  /**
+   * @brief Size of the sequence space enumerated in the selected order, this is greater or equal to the tile count
+   */
+  [[nodiscard]] constexpr auto get_sequence_size() const noexcept -> uint32_t
+  {
+    return static_cast<uint32_t>(sequence_size(order_));
+  }
+
+  /**
+   * @brief Decodes a sequence index into tile bounds.
+   * @return false if the sequence index does not map to a tile inside the range
+   */
+  [[nodiscard]] constexpr auto get_tile(uint32_t seq, tile_type& out) const noexcept -> bool
+  {
+    std::array<uint32_t, Dim> coord{};
+    switch (order_)
+    {
+    case tile_order::morton:
+      coord = decode_morton(seq);
+      break;
+    case tile_order::hilbert:
+      coord = decode_hilbert(seq);
+      break;
+    case tile_order::row_major:
+    default:
+      for (uint32_t d = 0; d < Dim; ++d)
+      {
+        coord[d] = seq % tile_count_[d];
+        seq /= tile_count_[d];
+      }
+      break;
+    }
+
+    for (uint32_t d = 0; d < Dim; ++d)
+    {
+      if (coord[d] >= tile_count_[d])
+      {
+        return false;
+      }
+      auto begin = static_cast<I>(extent_[d].begin() + static_cast<I>(coord[d]) * tile_[d]);
+      auto end   = static_cast<I>(std::min<I>(static_cast<I>(begin + tile_[d]), extent_[d].end()));
+      out[d]     = range_type(begin, end);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Invokes fn(tile_type const&) on every valid tile in the sequence range [first, last)
+   */
+  template <typename Fn>
+  constexpr void for_each_tile(uint32_t first, uint32_t last, Fn&& fn) const
+  {
+    tile_type tile;
+    for (; first != last; ++first)
+    {
+      if (get_tile(first, tile))
+      {
+        fn(tile);
+      }
+    }
+  }
+
+private:
+  /**
+   * @brief Sequence size of an order, computed in 64 bits so that it can be checked against the index range
+   */
+  [[nodiscard]] constexpr auto sequence_size(tile_order order) const noexcept -> uint64_t
+  {
+    uint64_t count = 1;
+    for (auto c : tile_count_)
+    {
+      count *= c;
+    }
+    if (count == 0)
+    {
+      return 0;
+    }
+
+    switch (order)
+    {
+    case tile_order::morton:
+    {
+      uint32_t total_bits = 0;
+      for (auto b : bits_)
+      {
+        total_bits += b;
+      }
+      return total_bits < std::numeric_limits<uint64_t>::digits ? uint64_t{1} << total_bits
+                                                                 : std::numeric_limits<uint64_t>::max();
+    }
+    case tile_order::hilbert:
+    {
+      uint64_t long_side = std::max(tile_count_[0], tile_count_[Dim - 1]);
+      uint64_t side      = hilbert_side_;
+      return ((long_side + side - 1) / side) * side * side;
+    }
+    case tile_order::row_major:
+    default:
+      return count;
+    }
+  }
+
+  [[nodiscard]] constexpr auto decode_morton(uint32_t seq) const noexcept -> std::array<uint32_t, Dim>
+  {
+    // Bits are interleaved while every dimension has bits remaining, the remaining high bits belong to the longer
+    // dimensions. This keeps the sequence dense for non-square grids.
+    std::array<uint32_t, Dim> coord{};
+    uint32_t                  pos      = 0;
+    uint32_t                  max_bits = 0;
+    for (auto b : bits_)
+    {
+      max_bits = std::max(max_bits, b);
+    }
+    for (uint32_t level = 0; level < max_bits; ++level)
+    {
+      for (uint32_t d = 0; d < Dim; ++d)
+      {
+        if (level < bits_[d])
+        {
+          coord[d] |= ((seq >> pos++) & 1U) << level;
+        }
+      }
+    }
+    return coord;
+  }
+
+  [[nodiscard]] constexpr auto decode_hilbert([[maybe_unused]] uint32_t seq) const noexcept -> std::array<uint32_t, Dim>
+  {
+    std::array<uint32_t, Dim> coord{};
+    if constexpr (Dim == 2)
+    {
+      // The grid is cut into squares along the longer side, each square is traversed by a hilbert curve that starts
+      // at its first corner and ends at the adjacent corner of the next square.
+      auto     area  = hilbert_side_ * hilbert_side_;
+      auto     block = seq / area;
+      auto     t     = seq % area;
+      uint32_t x     = 0;
+      uint32_t y     = 0;
+      for (uint32_t s = 1; s < hilbert_side_; s <<= 1U)
+      {
+        uint32_t rx = 1U & (t >> 1U);
+        uint32_t ry = 1U & (t ^ rx);
+        if (ry == 0)
+        {
+          if (rx == 1)
+          {
+            x = s - 1 - x;
+            y = s - 1 - y;
+          }
+          std::swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        t >>= 2U;
+      }
+      x += block * hilbert_side_;
+      if (tile_count_[0] >= tile_count_[1])
+      {
+        coord = {x, y};
+      }
+      else
+      {
+        coord = {y, x};
+      }
+    }
+    return coord;
+  }
+
+  extent_type               extent_{};
+  tile_size                 tile_{};
+  std::array<uint32_t, Dim> tile_count_{};
+  std::array<uint32_t, Dim> bits_{};
+  uint32_t                  hilbert_side_ = 1;
+  tile_order                order_        = tile_order::row_major;
+};
+
+template <typename I = uint32_t>
+using blocked_range2d = basic_blocked_range<I, 2>;
+
+template <typename I = uint32_t>
+using blocked_range3d = basic_blocked_range<I, 3>;
+
+} // namespace ouly
@@ -16,6 +16,14 @@ inline static constexpr bool debug = false;
 #endif
 } // namespace ouly
 
+namespace ouly::detail
+{
+/**
+ * @brief Assumed size of a cache line, used to keep data written by different threads apart
+ */
+inline static constexpr uint32_t cache_line_size = 64;
+} // namespace ouly::detail
+
 #ifdef _MSC_VER
 #define OULY_POTENTIAL_EMPTY_MEMBER [[msvc::no_unique_address]]
 #else
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define OULY_HAS_RDTSC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define OULY_HAS_RDTSC
+#endif
+
+namespace ouly
+{
+
+/**
+ * @brief A low overhead monotonic tick counter.
+ *
+ * Reads the time stamp counter on x86 and the virtual counter on arm64, falls back to std::chrono::steady_clock
+ * otherwise. Ticks can be converted to time using ticks_per_us(), which is calibrated once per process.
+ * @note The counter is meant for measuring short intervals on the same thread, it is not serializing.
+ */
+struct tsc_clock
+{
+  static auto now() noexcept -> uint64_t
+  {
+#if defined(OULY_HAS_RDTSC)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value = 0;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now().time_since_epoch())
+                                  .count());
+#endif
+  }
+
+  /**
+   * @brief Number of ticks per microsecond
+   */
+  static auto ticks_per_us() noexcept -> double
+  {
+    static double const value = calibrate();
+    return value;
+  }
+
+  static auto to_us(uint64_t ticks) noexcept -> double
+  {
+    return static_cast<double>(ticks) / ticks_per_us();
+  }
+
+  static auto from_us(double us) noexcept -> uint64_t
+  {
+    return static_cast<uint64_t>(us * ticks_per_us());
+  }
+
+private:
+  static auto calibrate() noexcept -> double
+  {
+#if defined(OULY_HAS_RDTSC)
+    using namespace std::chrono_literals;
+    auto start_time  = std::chrono::steady_clock::now();
+    auto start_ticks = now();
+    auto end_time    = start_time;
+    while (end_time - start_time < 200us)
+    {
+      end_time = std::chrono::steady_clock::now();
+    }
+    auto end_ticks = now();
+    return static_cast<double>(end_ticks - start_ticks) /
+           std::chrono::duration<double, std::micro>(end_time - start_time).count();
+#elif defined(__aarch64__)
+    constexpr double us_per_s = 1000000.0;
+    uint64_t         freq     = 0;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    return static_cast<double>(freq) / us_per_s;
+#else
+    constexpr double ns_per_us = 1000.0;
+    return ns_per_us;
+#endif
+  }
+};
+
+} // namespace ouly
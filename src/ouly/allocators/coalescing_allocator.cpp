@@ -1,134 +1,211 @@
 
 #include "ouly/allocators/coalescing_allocator.hpp"
+#include "ouly/allocators/detail/simd_search.hpp"
+#include <algorithm>
 
 namespace ouly
 {
-#define OULY_BINARY_SEARCH_STEP2                                                                                       \
-  {                                                                                                                    \
-    const auto* const middle = it + (size >> 1);                                                                       \
-    size                     = (size + 1) >> 1;                                                                        \
-    it                       = *middle < key ? middle : it;                                                            \
-  }
+namespace
+{
+// Used up entries are only compacted once there are enough of them to be worth a pass over the arrays, a run of
+// this many is also compacted so the walks over it stay short
+constexpr std::size_t min_compact_count = 64;
+// How far a new free block looks for a used up entry to take before it grows the arrays
+constexpr std::size_t reuse_window = 32;
+} // namespace
 
-static inline auto mini2(auto const* it, size_t size, auto key) noexcept
+auto coalescing_allocator::allocate(size_type size) -> coalescing_allocator::size_type
 {
-  while (true)
+  // best fit, smallest block that can hold the size, lowest offset among equals
+  auto best = by_size_.lower_bound({size, 0});
+  if (best == by_size_.end())
   {
-    OULY_BINARY_SEARCH_STEP2;
-    OULY_BINARY_SEARCH_STEP2;
-    if (size <= 2)
-    {
-      break;
-    }
+    return std::numeric_limits<uint32_t>::max();
   }
 
-  it += size > 1 && (*it < key);
-  it += size > 0 && (*it < key);
-  return it;
-}
-
-#define OULY_BINARY_SEARCH_STEP_INDIRECT                                                                               \
-  {                                                                                                                    \
-    const auto* const middle = it + (size >> 1);                                                                       \
-    size                     = (size + 1) >> 1;                                                                        \
-    it                       = data[*middle] < key ? middle : it;                                                      \
+  auto [block_size, offset] = *best;
+  auto first                = find(offset);
+  auto idx                  = first;
+  // Used up entries may share the offset
+  while (sizes_[idx] == 0)
+  {
+    ++idx;
   }
+  assert(offsets_[idx] == offset);
 
-static inline auto mini2(auto const* it, auto const* data, size_t size, auto key) noexcept
-{
-  while (true)
+  if (block_size == size)
   {
-    OULY_BINARY_SEARCH_STEP_INDIRECT;
-    OULY_BINARY_SEARCH_STEP_INDIRECT;
-    if (size <= 2)
-    {
-      break;
-    }
+    tombstone(idx);
   }
-  it += size > 1 && (data[*it] < key);
-  it += size > 0 && (data[*it] < key);
-  return it;
-}
-
-auto coalescing_allocator::allocate(size_type size) -> coalescing_allocator::size_type
-{
-  // first fit
-  for (uint32_t i = 0, end = static_cast<uint32_t>(sizes_.size()); i < end; ++i)
+  else
   {
-    if (size <= sizes_[i])
-    {
-      auto ret = offsets_[i];
-      sizes_[i] -= size;
-      offsets_[i] += size;
-      if (sizes_[i] == 0U)
-      {
-        offsets_.erase(i + offsets_.begin());
-        sizes_.erase(i + sizes_.begin());
-      }
-      return ret;
-    }
+    resize_free(idx, offset + size, block_size - size);
   }
-
-  return std::numeric_limits<uint32_t>::max();
+  if (needs_compact(idx - first))
+  {
+    compact();
+  }
+  return offset;
 }
 
 void coalescing_allocator::deallocate(size_type offset, size_type size)
 {
-  assert(!offsets_.empty());
+  auto idx = find(offset);
+  auto end = offsets_.size();
+
+  // Closest live blocks on either side, skipping used up entries
+  auto prev = idx;
+  while (prev > 0 && sizes_[prev - 1] == 0)
+  {
+    --prev;
+  }
+  auto next = idx;
+  while (next < end && sizes_[next] == 0)
+  {
+    ++next;
+  }
 
-  const auto* it = mini2(offsets_.data(), offsets_.size(), offset);
+  bool merge_prev = prev > 0 && offsets_[prev - 1] + sizes_[prev - 1] == offset;
+  bool merge_next = next < end && offsets_[next] == offset + size;
 
-  if (it == offsets_.data())
+  if (merge_prev && merge_next)
   {
-    if (offset + size == offsets_.front())
-    {
-      offsets_.front() = offset;
-      sizes_.front() += size;
-    }
-    else
-    {
-      offsets_.insert(offsets_.begin(), offset);
-      sizes_.insert(sizes_.begin(), size);
-    }
+    auto next_size = sizes_[next];
+    tombstone(next);
+    resize_free(prev - 1, offsets_[prev - 1], sizes_[prev - 1] + size + next_size);
+    settle(prev - 1);
+  }
+  else if (merge_prev)
+  {
+    resize_free(prev - 1, offsets_[prev - 1], sizes_[prev - 1] + size);
+    settle(prev - 1);
   }
-  else if (it == offsets_.data() + offsets_.size())
+  else if (merge_next)
   {
-    if (offsets_.back() + sizes_.back() == offset)
+    if (idx == next)
     {
-      sizes_.back() += size;
+      resize_free(next, offset, sizes_[next] + size);
     }
-    // no merge, push at end
     else
     {
-      offsets_.emplace_back(offset);
-      sizes_.emplace_back(size);
+      // Moving the next block down past used up entries would break the order, take the first of them instead
+      auto merged = sizes_[next] + size;
+      tombstone(next);
+      revive(idx, offset, merged);
+      settle(idx);
     }
   }
   else
   {
-    auto idx = static_cast<size_type>(std::distance(static_cast<size_type const*>(offsets_.data()), it));
-    if (offsets_[idx - 1] + sizes_[idx - 1] == offset)
+    auto slot = open_slot(idx);
+    revive(slot, offset, size);
+    settle(slot);
+  }
+
+  if (needs_compact((idx - prev) + (next - idx)))
+  {
+    compact();
+  }
+}
+
+auto coalescing_allocator::find(size_type offset) const noexcept -> std::size_t
+{
+  return static_cast<std::size_t>(ouly::detail::simd_lower_bound(offsets_.data(), offsets_.size(), offset) -
+                                  offsets_.data());
+}
+
+auto coalescing_allocator::needs_compact(std::size_t walked) const noexcept -> bool
+{
+  return walked >= min_compact_count || (empty_ >= min_compact_count && empty_ * 2 >= offsets_.size());
+}
+
+auto coalescing_allocator::open_slot(std::size_t idx) -> std::size_t
+{
+  // Take the closest used up entry and shift the live ones in between by one, they stay sorted
+  auto end     = offsets_.size();
+  auto offsets = offsets_.begin();
+  auto sizes   = sizes_.begin();
+  auto at      = static_cast<std::ptrdiff_t>(idx);
+  for (std::size_t d = 0; d < reuse_window; ++d)
+  {
+    auto right = idx + d;
+    if (right < end && sizes_[right] == 0)
     {
-      sizes_[idx - 1] += size;
-
-      if (offsets_[idx] == offsets_[idx - 1] + sizes_[idx - 1])
-      {
-        sizes_[idx - 1] += sizes_[idx];
-        offsets_.erase(offsets_.begin() + idx);
-        sizes_.erase(sizes_.begin() + idx);
-      }
+      auto last = static_cast<std::ptrdiff_t>(right);
+      std::move_backward(offsets + at, offsets + last, offsets + last + 1);
+      std::move_backward(sizes + at, sizes + last, sizes + last + 1);
+      sizes_[idx] = 0;
+      return idx;
     }
-    else if (offsets_[idx] == offset + size)
+    if (d < idx && sizes_[idx - d - 1] == 0)
     {
-      offsets_[idx] -= size;
-      sizes_[idx] += size;
+      auto first = static_cast<std::ptrdiff_t>(idx - d - 1);
+      std::move(offsets + first + 1, offsets + at, offsets + first);
+      std::move(sizes + first + 1, sizes + at, sizes + first);
+      sizes_[idx - 1] = 0;
+      return idx - 1;
     }
-    else
+  }
+
+  // Nothing close enough, grow the arrays
+  offsets_.insert(offsets + at, 0);
+  sizes_.insert(sizes + at, 0);
+  empty_++;
+  return idx;
+}
+
+void coalescing_allocator::resize_free(std::size_t idx, size_type offset, size_type size)
+{
+  // Reuse the index node, a resize does not allocate
+  auto node = by_size_.extract({sizes_[idx], offsets_[idx]});
+  assert(!node.empty());
+  node.value() = {size, offset};
+  by_size_.insert(std::move(node));
+  offsets_[idx] = offset;
+  sizes_[idx]   = size;
+}
+
+void coalescing_allocator::revive(std::size_t idx, size_type offset, size_type size)
+{
+  assert(sizes_[idx] == 0);
+  offsets_[idx] = offset;
+  sizes_[idx]   = size;
+  by_size_.emplace(size, offset);
+  empty_--;
+}
+
+void coalescing_allocator::tombstone(std::size_t idx)
+{
+  by_size_.erase({sizes_[idx], offsets_[idx]});
+  sizes_[idx] = 0;
+  empty_++;
+}
+
+void coalescing_allocator::settle(std::size_t idx)
+{
+  // Used up entries that follow a live block must not sort before any offset the block can be bumped to
+  auto block_end = offsets_[idx] + sizes_[idx];
+  for (auto end = offsets_.size(); ++idx < end && sizes_[idx] == 0 && offsets_[idx] < block_end;)
+  {
+    offsets_[idx] = block_end;
+  }
+}
+
+void coalescing_allocator::compact()
+{
+  std::size_t out = 0;
+  for (std::size_t i = 0, end = offsets_.size(); i < end; ++i)
+  {
+    if (sizes_[i] != 0)
     {
-      offsets_.insert(offsets_.begin() + idx, offset);
-      sizes_.insert(sizes_.begin() + idx, size);
+      offsets_[out] = offsets_[i];
+      sizes_[out]   = sizes_[i];
+      ++out;
     }
   }
+  offsets_.resize(out);
+  sizes_.resize(out);
+  empty_ = 0;
 }
 
 } // namespace ouly
@@ -1,6 +1,8 @@
 
 #include "ouly/allocators/coalescing_arena_allocator.hpp"
+#include <algorithm>
 #include <cstddef>
+#include <numeric>
 
 namespace ouly
 {
@@ -57,6 +59,92 @@ auto coalescing_arena_allocator::commit(size_type size, size_type const* found)
   return free_node;
 }
 
+void coalescing_arena_allocator::sort_batch(std::span<size_type const> sizes)
+{
+  batch_order_.resize(sizes.size());
+  std::iota(batch_order_.begin(), batch_order_.end(), 0U);
+  std::ranges::sort(batch_order_,
+                    [sizes](std::uint32_t a, std::uint32_t b)
+                    {
+                      return sizes[a] < sizes[b];
+                    });
+}
+
+auto coalescing_arena_allocator::allocate_sorted(std::span<size_type const> sizes, std::span<ca_allocation> out,
+                                                 std::uint32_t first, std::uint32_t last) -> std::uint32_t
+{
+  // Taking a free block only moves smaller sizes before it, so the next larger request is found at or after it
+  std::size_t hint = 0;
+  for (; first < last; ++first)
+  {
+    auto const index = batch_order_[first];
+    auto const size  = sizes[index];
+    if (sizes_.empty() || sizes_.back() < size)
+    {
+      break;
+    }
+
+    [[maybe_unused]] auto measure = statistics::report_allocate(size);
+
+    const auto* found = mini2(sizes_.data() + hint, sizes_.size() - hint, size);
+    hint              = static_cast<std::size_t>(std::distance(static_cast<size_type const*>(sizes_.data()), found));
+
+    auto id            = commit(size, found);
+    out[index].offset_ = block_entries_.offsets_[id];
+    out[index].id_     = {.id_ = id};
+    out[index].arena_  = {.id_ = block_entries_.arenas_[id]};
+  }
+  return first;
+}
+
+auto coalescing_arena_allocator::deallocate_sorted(std::span<allocation_id const> ids) -> std::span<arena_id const>
+{
+  batch_order_.resize(ids.size());
+  std::ranges::transform(ids, batch_order_.begin(),
+                         [](allocation_id id)
+                         {
+                           return id.get();
+                         });
+  std::ranges::sort(batch_order_,
+                    [this](std::uint32_t a, std::uint32_t b)
+                    {
+                      return std::make_pair(block_entries_.arenas_[a], block_entries_.offsets_[a]) <
+                             std::make_pair(block_entries_.arenas_[b], block_entries_.offsets_[b]);
+                    });
+
+  batch_arenas_.clear();
+  for (std::size_t i = 0, count = batch_order_.size(); i < count;)
+  {
+    auto const node  = batch_order_[i];
+    auto const arena = block_entries_.arenas_[node];
+    auto&      list  = arena_entries_.entries_[arena].blocks_;
+    auto       end   = block_entries_.offsets_[node] + block_entries_.sizes_[node];
+
+    [[maybe_unused]] auto measure = statistics::report_deallocate(block_entries_.sizes_[node]);
+
+    // Blocks of the batch that follow this one are folded into it, so the run is released as a single block
+    for (++i; i < count && block_entries_.arenas_[batch_order_[i]] == arena &&
+              block_entries_.offsets_[batch_order_[i]] == end;
+         ++i)
+    {
+      auto const next      = batch_order_[i];
+      auto const next_size = block_entries_.sizes_[next];
+
+      [[maybe_unused]] auto next_measure = statistics::report_deallocate(next_size);
+
+      end += next_size;
+      block_entries_.sizes_[node] += next_size;
+      list.erase(block_entries_, next);
+    }
+
+    if (auto dropped = deallocate(allocation_id{node}); dropped != arena_id())
+    {
+      batch_arenas_.push_back(dropped);
+    }
+  }
+  return batch_arenas_;
+}
+
 void coalescing_arena_allocator::reinsert_left(size_t of, size_type size, std::uint32_t node)
 {
   if (of == 0U)
@@ -96,8 +184,6 @@ auto coalescing_arena_allocator::deallocate(allocation_id id) -> arena_id
 {
   auto const node = id.id_;
   auto const size = block_entries_.sizes_[node];
-  // NOLINTNEXTLINE
-  [[maybe_unused]] auto measure = statistics::report_deallocate(size);
 
   enum : std::uint8_t
   {
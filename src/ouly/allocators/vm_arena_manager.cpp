@@ -0,0 +1,268 @@
+#include "ouly/allocators/vm_arena_manager.hpp"
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ouly
+{
+namespace detail
+{
+namespace
+{
+constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+auto round_up(std::size_t size, std::size_t granularity) noexcept -> std::size_t
+{
+  return ((size + granularity - 1) / granularity) * granularity;
+}
+
+auto system_page_size() noexcept -> std::size_t
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return static_cast<std::size_t>(info.dwPageSize);
+#else
+  return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+} // namespace
+
+auto vm_granularity(cfg::vm_page_mode mode) noexcept -> std::size_t
+{
+  static std::size_t const page_size = system_page_size();
+#ifdef _WIN32
+  (void)mode;
+  return page_size;
+#else
+  return mode == cfg::vm_page_mode::e_default ? page_size : huge_page_size;
+#endif
+}
+
+#ifdef _WIN32
+
+auto vm_reserve(std::size_t size, [[maybe_unused]] cfg::vm_page_mode mode) noexcept -> void*
+{
+  // Large pages need a privilege and must be committed on reservation, regular pages are used instead
+  return VirtualAlloc(nullptr, round_up(size, vm_granularity(mode)), MEM_RESERVE, PAGE_NOACCESS);
+}
+
+auto vm_commit(void* addr, std::size_t size) noexcept -> bool
+{
+  return VirtualAlloc(addr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
+
+void vm_decommit(void* addr, std::size_t size) noexcept
+{
+  VirtualFree(addr, size, MEM_DECOMMIT);
+}
+
+void vm_release(void* addr, [[maybe_unused]] std::size_t size, [[maybe_unused]] cfg::vm_page_mode mode) noexcept
+{
+  VirtualFree(addr, 0, MEM_RELEASE);
+}
+
+#else
+
+auto vm_reserve(std::size_t size, cfg::vm_page_mode mode) noexcept -> void*
+{
+  auto granularity = vm_granularity(mode);
+  size             = round_up(size, granularity);
+
+#ifdef MAP_HUGETLB
+  if (mode == cfg::vm_page_mode::e_huge_tlb)
+  {
+    // Huge pages are reserved from the pool for the whole range, with MAP_NORESERVE an empty pool would only be
+    // noticed as SIGBUS on first touch
+    // NOLINTNEXTLINE(hicpp-signed-bitwise)
+    void* ptr = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED)
+    {
+      return ptr;
+    }
+    // No huge pages configured, fall through to regular pages with the same granularity
+  }
+#endif
+
+  // Over reserve so that the range can be aligned to the granularity, huge pages are only used for aligned ranges
+  auto  extra = granularity > vm_granularity(cfg::vm_page_mode::e_default) ? granularity : 0;
+  // NOLINTNEXTLINE(hicpp-signed-bitwise)
+  void* ptr   = mmap(nullptr, size + extra, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (ptr == MAP_FAILED)
+  {
+    return nullptr;
+  }
+
+  auto* first = static_cast<std::uint8_t*>(ptr);
+  if (extra != 0)
+  {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto* aligned = reinterpret_cast<std::uint8_t*>(round_up(reinterpret_cast<std::uintptr_t>(first), granularity));
+    auto  head    = static_cast<std::size_t>(aligned - first);
+    if (head != 0)
+    {
+      munmap(first, head);
+    }
+    if (extra - head != 0)
+    {
+      munmap(aligned + size, extra - head);
+    }
+    first = aligned;
+  }
+
+#ifdef MADV_HUGEPAGE
+  if (mode == cfg::vm_page_mode::e_transparent_huge)
+  {
+    madvise(first, size, MADV_HUGEPAGE);
+  }
+#endif
+  return first;
+}
+
+auto vm_commit(void* addr, std::size_t size) noexcept -> bool
+{
+  // NOLINTNEXTLINE(hicpp-signed-bitwise)
+  return mprotect(addr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void vm_decommit(void* addr, std::size_t size) noexcept
+{
+  madvise(addr, size, MADV_DONTNEED);
+  mprotect(addr, size, PROT_NONE);
+}
+
+void vm_release(void* addr, std::size_t size, cfg::vm_page_mode mode) noexcept
+{
+  munmap(addr, round_up(size, vm_granularity(mode)));
+}
+
+#endif
+} // namespace detail
+
+vm_arena_manager::vm_arena_manager(std::size_t max_arena_size, std::uint32_t max_arenas,
+                                   cfg::vm_page_mode mode) noexcept
+    : granularity_(detail::vm_granularity(mode)), max_arenas_(max_arenas), mode_(mode)
+{
+  slot_size_ = detail::round_up(max_arena_size, granularity_);
+  base_      = static_cast<std::uint8_t*>(detail::vm_reserve(slot_size_ * max_arenas_, mode_));
+  if (base_ == nullptr)
+  {
+    max_arenas_ = 0;
+  }
+  committed_.resize(max_arenas_, 0);
+  free_slots_.reserve(max_arenas_);
+  for (auto slot = max_arenas_; slot > 0; --slot)
+  {
+    free_slots_.push_back(slot - 1);
+  }
+}
+
+vm_arena_manager::vm_arena_manager(vm_arena_manager&& other) noexcept
+    : base_(std::exchange(other.base_, nullptr)), slot_size_(other.slot_size_), granularity_(other.granularity_),
+      committed_size_(std::exchange(other.committed_size_, 0)), committed_(std::move(other.committed_)),
+      free_slots_(std::move(other.free_slots_)), max_arenas_(std::exchange(other.max_arenas_, 0)), mode_(other.mode_)
+{}
+
+vm_arena_manager::~vm_arena_manager() noexcept
+{
+  if (base_ != nullptr)
+  {
+    detail::vm_release(base_, slot_size_ * max_arenas_, mode_);
+  }
+}
+
+auto vm_arena_manager::operator=(vm_arena_manager&& other) noexcept -> vm_arena_manager&
+{
+  if (this != &other)
+  {
+    if (base_ != nullptr)
+    {
+      detail::vm_release(base_, slot_size_ * max_arenas_, mode_);
+    }
+    base_           = std::exchange(other.base_, nullptr);
+    slot_size_      = other.slot_size_;
+    granularity_    = other.granularity_;
+    committed_size_ = std::exchange(other.committed_size_, 0);
+    committed_      = std::move(other.committed_);
+    free_slots_     = std::move(other.free_slots_);
+    max_arenas_     = std::exchange(other.max_arenas_, 0);
+    mode_           = other.mode_;
+  }
+  return *this;
+}
+
+auto vm_arena_manager::add_arena([[maybe_unused]] std::uint32_t id, std::size_t size) -> std::uint32_t
+{
+  if (free_slots_.empty() || size > slot_size_)
+  {
+    return invalid_arena;
+  }
+
+  auto slot = free_slots_.back();
+  free_slots_.pop_back();
+  if (!grow_arena(slot, size))
+  {
+    free_slots_.push_back(slot);
+    return invalid_arena;
+  }
+  return slot;
+}
+
+auto vm_arena_manager::drop_arena(std::uint32_t slot) -> bool
+{
+  release_slot(slot);
+  return true;
+}
+
+void vm_arena_manager::remove_arena(std::uint32_t slot)
+{
+  release_slot(slot);
+}
+
+auto vm_arena_manager::grow_arena(std::uint32_t slot, std::size_t size) -> bool
+{
+  assert(slot < max_arenas_);
+  size = detail::round_up(size, granularity_);
+  if (size > slot_size_)
+  {
+    return false;
+  }
+
+  auto& committed = committed_[slot];
+  if (size <= committed)
+  {
+    return true;
+  }
+
+  // Only the new tail is committed, the pages already in use are left untouched
+  if (!detail::vm_commit(static_cast<std::uint8_t*>(get_arena_data(slot)) + committed, size - committed))
+  {
+    return false;
+  }
+  committed_size_ += size - committed;
+  committed = size;
+  return true;
+}
+
+void vm_arena_manager::release_slot(std::uint32_t slot) noexcept
+{
+  assert(slot < max_arenas_);
+  auto& committed = committed_[slot];
+  if (committed != 0)
+  {
+    detail::vm_decommit(get_arena_data(slot), committed);
+    committed_size_ -= committed;
+    committed = 0;
+  }
+  free_slots_.push_back(slot);
+}
+
+} // namespace ouly
@@ -1,16 +1,62 @@
-
 #include "ouly/scheduler/event_types.hpp"
 #include "ouly/scheduler/scheduler.hpp"
+#include <thread>
 
 namespace ouly
 {
 
-void busywork_event::wait(worker_id worker, scheduler& sc)
+busywork_event::busywork_event(scheduler& s) noexcept : owner_(&s), worker_(s.get_local_worker()) {}
+
+void busywork_event::wait() noexcept
+{
+  if (worker_)
+  {
+    owner_->help_until(worker_, set_);
+    return;
+  }
+
+  while (!set_.load(std::memory_order_acquire))
+  {
+    set_.wait(false, std::memory_order_acquire);
+  }
+  wait_notified();
+}
+
+void busywork_event::wait(worker_id worker, scheduler& s) noexcept
+{
+  while (!set_.load(std::memory_order_acquire))
+  {
+    if (!s.busy_work(worker))
+    {
+      std::this_thread::yield();
+    }
+  }
+  wait_notified();
+}
+
+void busywork_event::wait_notified() const noexcept
 {
-  using namespace std::chrono_literals;
-  while (!semaphore_.try_acquire())
+  // notify_one() may still be running on set_, the event must outlive it
+  while (!notified_.load(std::memory_order_acquire))
+  {
+    std::this_thread::yield();
+  }
+}
+
+void busywork_event::notify() noexcept
+{
+  // The waiter may return and destroy the event as soon as the flag is set
+  auto* owner  = owner_;
+  auto  worker = worker_;
+  set_.store(true);
+  if (worker)
+  {
+    owner->wake_up(worker);
+  }
+  else
   {
-    sc.busy_work(worker);
+    set_.notify_one();
+    notified_.store(true, std::memory_order_release);
   }
 }
-} // namespace ouly
\ No newline at end of file
+} // namespace ouly
@@ -1,25 +1,84 @@
 
 #include "ouly/scheduler/scheduler.hpp"
 #include "ouly/scheduler/task.hpp"
+#include <algorithm>
+#include <cassert>
+#include <limits>
 #include <latch>
 #include <numeric>
+#include <vector>
 
 namespace ouly
 {
 
+namespace
+{
+/**
+ * @brief Worker of a scheduler the current thread is bound to
+ */
+struct thread_binding
+{
+  scheduler const*            owner_    = nullptr;
+  uint64_t                    instance_ = 0;
+  ouly::detail::worker const* worker_   = nullptr;
+};
+
+auto find_binding(std::vector<thread_binding>& bindings, scheduler const* owner, uint64_t instance) noexcept
+ -> thread_binding*
+{
+  for (auto& b : bindings)
+  {
+    if (b.owner_ == owner && b.instance_ == instance)
+    {
+      return &b;
+    }
+  }
+  return nullptr;
+}
+
+std::atomic_uint64_t g_instance_counter = 0; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables)
+} // namespace
+
+// Worker of the scheduler this thread was most recently bound to
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
 thread_local ouly::detail::worker const* g_worker = nullptr;
+// All schedulers this thread is bound to, a thread is usually bound to one or two schedulers
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+thread_local std::vector<thread_binding> g_bindings;
 
 auto worker_context::get(workgroup_id group) noexcept -> worker_context const&
 {
   return g_worker->contexts_[group.get_index()];
 }
 
+auto worker_context::get(scheduler& s, workgroup_id group) noexcept -> worker_context const&
+{
+  auto id = s.get_local_worker();
+  assert(id && "Current thread is not a worker of this scheduler");
+  return s.get_context(id, group);
+}
+
+auto worker_context::get_scratch_arena() const noexcept -> scratch_arena&
+{
+  assert(owner_);
+  return owner_->get_scratch_arena(index_);
+}
+
+auto scratch_allocator::local_arena() noexcept -> scratch_arena*
+{
+  return g_worker != nullptr ? &g_worker->scratch_ : nullptr;
+}
+
 auto worker_id::get() noexcept -> worker_id const&
 {
   return g_worker->id_;
 }
 
+auto worker_id::get(scheduler const& s) noexcept -> worker_id
+{
+  return s.get_local_worker();
+}
+
 scheduler::~scheduler() noexcept
 {
   if (!stop_.load())
@@ -33,37 +92,34 @@ inline void scheduler::do_work(worker_id thread, ouly::detail::work_item& work)
   work(workers_[thread.get_index()].contexts_[work.get_compressed_data<ouly::workgroup_id>().get_index()]);
 }
 
-void scheduler::busy_work(worker_id thread) noexcept
+auto scheduler::busy_work(worker_id thread) noexcept -> bool
 {
+  return run_local_work(thread) || work(thread);
+}
+
+inline auto scheduler::run_local_work(worker_id thread) noexcept -> bool
+{
+  auto& lw = local_work_[thread.get_index()];
+  if (!lw)
   {
-    auto& lw = local_work_[thread.get_index()];
-    if (lw)
-    {
-      do_work(thread, lw);
-      lw = nullptr;
-      return;
-    }
+    return false;
   }
-
-  work(thread);
+  // Take the item out before running it, the task may wait and pick up new local work on this worker
+  auto item = std::move(lw);
+  lw        = nullptr;
+  do_work(thread, item);
+  return true;
 }
 
 void scheduler::run(worker_id thread)
 {
-  g_worker = &workers_[thread.get_index()];
+  bind_thread(thread);
 
   entry_fn_(worker_desc(thread, group_ranges_[thread.get_index()].mask_));
 
   while (true)
   {
-    {
-      auto& lw = local_work_[thread.get_index()];
-      if (lw)
-      {
-        do_work(thread, lw);
-        lw = nullptr;
-      }
-    }
+    run_local_work(thread);
 
     while (work(thread))
     {
@@ -104,9 +160,20 @@ auto scheduler::get_work(worker_id thread) noexcept -> ouly::detail::work_item
   {
     auto  group_id = range.priority_order_[start];
     auto& group    = workgroups_[group_id];
-    for (uint32_t queue_idx = 0, queue_end = group.thread_count_ - 1; queue_idx <= queue_end; ++queue_idx)
+    auto  own_idx  = thread.get_index() - group.start_thread_idx_;
+    auto* order    = group.steal_order_.get() + (static_cast<size_t>(own_idx) * group.thread_count_);
+    for (uint32_t queue_idx = 0, queue_end = group.thread_count_; queue_idx < queue_end; ++queue_idx)
     {
-      auto& queue = group.work_queues_[(thread.get_index() - group.start_thread_idx_ + queue_idx) & queue_end];
+      if (queue_idx == 1)
+      {
+        // Own queue is empty, pull in external submissions before stealing
+        if (auto item = drain_injection(thread, group))
+        {
+          return item;
+        }
+      }
+
+      auto& queue = group.work_queues_[order[queue_idx]];
       if (queue.first.try_lock())
       {
         if (!queue.second.empty())
@@ -118,6 +185,19 @@ auto scheduler::get_work(worker_id thread) noexcept -> ouly::detail::work_item
         queue.first.unlock();
       }
     }
+
+    if (group.thread_count_ == 1)
+    {
+      if (auto item = drain_injection(thread, group))
+      {
+        return item;
+      }
+    }
+
+    if (auto item = steal_continuation(thread, group, workgroup_id(group_id)))
+    {
+      return item;
+    }
   }
 
   // Exclusive
@@ -134,6 +214,132 @@ auto scheduler::get_work(worker_id thread) noexcept -> ouly::detail::work_item
   return {};
 }
 
+auto scheduler::drain_injection(worker_id thread, ouly::detail::workgroup& group) noexcept -> ouly::detail::work_item
+{
+  auto& injection = *group.injection_;
+  if (injection.pending_.load(std::memory_order_acquire) == 0 || !injection.consumer_.try_lock())
+  {
+    return {};
+  }
+
+  ouly::detail::work_item      first;
+  ouly::detail::injection_node* released_first = nullptr;
+  ouly::detail::injection_node* released_last  = nullptr;
+  uint32_t                      count          = 0;
+  {
+    auto& queue = group.work_queues_[thread.get_index() - group.start_thread_idx_];
+    auto  lck   = std::scoped_lock(queue.first);
+    for (; count < ouly::detail::max_injection_batch; ++count)
+    {
+      auto* node = injection.queue_.pop();
+      if (node == nullptr)
+      {
+        break;
+      }
+      if (count == 0)
+      {
+        first = std::move(node->work_);
+      }
+      else
+      {
+        queue.second.emplace_back(std::move(node->work_));
+      }
+      node->next_.store(released_first, std::memory_order_relaxed);
+      released_first = node;
+      if (released_last == nullptr)
+      {
+        released_last = node;
+      }
+    }
+  }
+  injection.consumer_.unlock();
+
+  if (count != 0)
+  {
+    injection.pending_.fetch_sub(count, std::memory_order_release);
+    injection_pool_.release(released_first, released_last);
+    if (count > 1)
+    {
+      wake_one(group);
+    }
+  }
+  return first;
+}
+
+auto scheduler::steal_continuation(worker_id thread, ouly::detail::workgroup const& group,
+                                   workgroup_id group_id) noexcept -> ouly::detail::work_item
+{
+  auto const* order = group.steal_order_.get() + (static_cast<size_t>(thread.get_index() - group.start_thread_idx_) *
+                                                  group.thread_count_);
+  for (uint32_t i = 1; i < group.thread_count_; ++i)
+  {
+    auto& deque = workers_[group.start_thread_idx_ + order[i]].continuations_;
+    auto  top   = deque.top_.load(std::memory_order_relaxed);
+    if (top == deque.bottom_.load(std::memory_order_relaxed) || !deque.lock_.try_lock())
+    {
+      continue;
+    }
+
+    top        = deque.top_.load(std::memory_order_relaxed);
+    auto entry = deque.entries_[top % ouly::detail::max_spawn_depth];
+    if (top != deque.bottom_.load(std::memory_order_relaxed) && entry.group_ == group_id)
+    {
+      deque.top_.store(top + 1, std::memory_order_relaxed);
+      deque.lock_.unlock();
+      return ouly::detail::work_item::pbind(
+       [address = entry.address_](worker_context const&)
+       {
+         std::coroutine_handle<>::from_address(address).resume();
+       },
+       group_id);
+    }
+    deque.lock_.unlock();
+  }
+  return {};
+}
+
+auto scheduler::push_continuation(worker_id worker, workgroup_id group, std::coroutine_handle<> continuation) noexcept
+ -> bool
+{
+  auto& deque  = workers_[worker.get_index()].continuations_;
+  auto  lck    = std::scoped_lock(deque.lock_);
+  auto  bottom = deque.bottom_.load(std::memory_order_relaxed);
+  if (bottom - deque.top_.load(std::memory_order_relaxed) == ouly::detail::max_spawn_depth)
+  {
+    return false;
+  }
+  deque.entries_[bottom % ouly::detail::max_spawn_depth] = {.address_ = continuation.address(), .group_ = group};
+  deque.bottom_.store(bottom + 1, std::memory_order_relaxed);
+  return true;
+}
+
+auto scheduler::pop_continuation(worker_id worker, std::coroutine_handle<> continuation) noexcept -> bool
+{
+  auto& deque  = workers_[worker.get_index()].continuations_;
+  auto  lck    = std::scoped_lock(deque.lock_);
+  auto  bottom = deque.bottom_.load(std::memory_order_relaxed);
+  // Thieves take from the top, if the most recent continuation is not ours it has been stolen
+  if (bottom == deque.top_.load(std::memory_order_relaxed) ||
+      deque.entries_[(bottom - 1) % ouly::detail::max_spawn_depth].address_ != continuation.address())
+  {
+    return false;
+  }
+  deque.bottom_.store(bottom - 1, std::memory_order_relaxed);
+  return true;
+}
+
+void scheduler::wake_one(ouly::detail::workgroup const& group) noexcept
+{
+  for (uint32_t i = group.start_thread_idx_, end = i + group.thread_count_; i != end; ++i)
+  {
+    if (!wake_status_[i].exchange(true))
+    {
+      wake_events_[i].notify();
+      return;
+    }
+  }
+}
+
 void scheduler::wake_up(worker_id thread) noexcept
 {
   if (!wake_status_[thread.get_index()].exchange(true))
@@ -143,6 +349,46 @@ void scheduler::wake_up(worker_id thread) noexcept
   }
 }
 
+void scheduler::help_until(worker_id thread, std::atomic_bool const& done) noexcept
+{
+  auto  idx    = thread.get_index();
+  auto& status = wake_status_[idx];
+
+  // Leaves the parked state, a wake up that raced with it leaves a token behind which is consumed here
+  auto reclaim = [&]()
+  {
+    if (status.exchange(true))
+    {
+      (void)wake_events_[idx].semaphore_.try_acquire();
+    }
+  };
+
+  while (!done.load())
+  {
+    if (run_local_work(thread) || work(thread))
+    {
+      continue;
+    }
+
+    // Announce parking before the final checks, a notify or a submission after this point wakes the worker
+    status.store(false);
+    if (done.load())
+    {
+      reclaim();
+      break;
+    }
+    if (auto item = get_work(thread))
+    {
+      reclaim();
+      do_work(thread, item);
+      continue;
+    }
+    wake_events_[idx].wait();
+  }
+
+  run_local_work(thread);
+}
+
 void scheduler::begin_execution(scheduler_worker_entry&& entry, void* user_context)
 {
   local_work_   = std::make_unique<ouly::detail::work_item[]>(worker_count_);
@@ -150,7 +396,7 @@ void scheduler::begin_execution(scheduler_worker_entry&& entry, void* user_conte
   group_ranges_ = std::make_unique<ouly::detail::group_range[]>(worker_count_);
   wake_status_  = std::make_unique<std::atomic_bool[]>(worker_count_);
   wake_events_  = std::make_unique<ouly::detail::wake_event[]>(worker_count_);
-  workers_      = std::make_unique<ouly::detail::worker[]>(worker_count_);
+  instance_id_  = g_instance_counter.fetch_add(1, std::memory_order_relaxed) + 1;
 
   threads_.reserve(worker_count_ - 1);
 
@@ -168,6 +414,12 @@ void scheduler::begin_execution(scheduler_worker_entry&& entry, void* user_conte
     }
   }
 
+  topology_.resize(worker_count_);
+  for (auto& g : workgroups_)
+  {
+    build_steal_order(g);
+  }
+
   for (uint32_t w = 0; w < worker_count_; ++w)
   {
     auto& worker = workers_[w];
@@ -210,14 +462,46 @@ void scheduler::begin_execution(scheduler_worker_entry&& entry, void* user_conte
     threads_.emplace_back(&scheduler::run, this, worker_id(thread));
   }
 
-  g_worker = &workers_[0];
+  bind_thread(main_worker_id);
   start_counter.wait();
   entry_fn_ = {};
 }
 
 void scheduler::take_ownership() noexcept
 {
-  g_worker = &workers_[0];
+  bind_thread(main_worker_id);
+}
+
+auto scheduler::get_local_worker() const noexcept -> worker_id
+{
+  auto const* binding = find_binding(g_bindings, this, instance_id_);
+  return binding != nullptr ? binding->worker_->id_ : external_worker_id;
+}
+
+void scheduler::bind_thread(worker_id thread) noexcept
+{
+  // The most recently bound scheduler is kept last, it is the fallback once the current one is unbound
+  if (auto* binding = find_binding(g_bindings, this, instance_id_))
+  {
+    g_bindings.erase(g_bindings.begin() + (binding - g_bindings.data()));
+  }
+  g_worker = &workers_[thread.get_index()];
+  g_bindings.emplace_back(thread_binding{.owner_ = this, .instance_ = instance_id_, .worker_ = g_worker});
+}
+
+void scheduler::unbind_thread() noexcept
+{
+  auto* binding = find_binding(g_bindings, this, instance_id_);
+  if (binding == nullptr)
+  {
+    return;
+  }
+  bool was_current = binding->worker_ == g_worker;
+  g_bindings.erase(g_bindings.begin() + (binding - g_bindings.data()));
+  if (was_current)
+  {
+    g_worker = g_bindings.empty() ? nullptr : g_bindings.back().worker_;
+  }
 }
 
 void scheduler::finish_pending_tasks() noexcept
@@ -229,7 +513,7 @@ void scheduler::finish_pending_tasks() noexcept
     has_work = false;
     for (auto& group : workgroups_)
     {
-      bool has_items = false;
+      bool has_items = group.thread_count_ != 0 && group.injection_->pending_.load() != 0;
       for (uint32_t q = 0; q < group.thread_count_; ++q)
       {
         auto lck = std::scoped_lock(group.work_queues_[q].first);
@@ -281,6 +565,7 @@ void scheduler::end_execution()
     threads_[thread - 1].join();
   }
   threads_.clear();
+  unbind_thread();
 }
 
 void scheduler::submit(worker_id src, worker_id dst, ouly::detail::work_item work)
@@ -303,7 +588,7 @@ void scheduler::submit(worker_id src, worker_id dst, ouly::detail::work_item wor
   }
 }
 
-void scheduler::submit([[maybe_unused]] worker_id src, workgroup_id dst, ouly::detail::work_item work)
+void scheduler::submit(worker_id src, workgroup_id dst, ouly::detail::work_item work)
 {
   auto& wg = workgroups_[dst.get_index()];
 
@@ -317,26 +602,107 @@ void scheduler::submit([[maybe_unused]] worker_id src, workgroup_id dst, ouly::d
     }
   }
 
-  while (true)
+  if (src.get_index() < worker_count_ && (group_ranges_[src.get_index()].mask_ & (1U << dst.get_index())) != 0)
+  {
+    // Submitting worker is part of the group, it will get to its own queue, others may steal from it
+    auto& queue = wg.work_queues_[src.get_index() - wg.start_thread_idx_];
+    auto  lck   = std::scoped_lock(queue.first);
+    queue.second.emplace_back(std::move(work));
+    return;
+  }
+
+  auto* node  = injection_pool_.acquire();
+  node->work_ = std::move(work);
+  // Count the node before publishing it, a consumer may pop and subtract it before push returns
+  wg.injection_->pending_.fetch_add(1, std::memory_order_release);
+  wg.injection_->queue_.push(node);
+  wake_one(wg);
+}
+
+void scheduler::submit(worker_id src, affinity_hint hint, workgroup_id dst, ouly::detail::work_item work)
+{
+  auto& wg        = workgroups_[dst.get_index()];
+  auto  preferred = hint.worker_.get_index();
+  if (preferred < wg.start_thread_idx_ || preferred - wg.start_thread_idx_ >= wg.thread_count_)
+  {
+    submit(src, dst, std::move(work));
+    return;
+  }
+
+  if (hint.scope_ == affinity_scope::shared_cache)
   {
-    wg.push_offset_++;
-    for (uint32_t i = 0, end = wg.thread_count_ - 1; i <= end; ++i)
+    auto cache = topology_[preferred].cache_id_;
+    for (uint32_t i = wg.start_thread_idx_, end = i + wg.thread_count_; i != end; ++i)
     {
-      uint32_t q     = (wg.push_offset_ + i) & end;
-      auto&    queue = wg.work_queues_[q];
-      if (queue.first.try_lock())
+      if (topology_[i].cache_id_ == cache && !wake_status_[i].exchange(true))
       {
-        queue.second.emplace_back(std::move(work));
-        queue.first.unlock();
-        q += wg.start_thread_idx_;
-        if (!wake_status_[q].exchange(true))
-        {
-          wake_events_[q].notify();
-        }
+        local_work_[i] = std::move(work);
+        wake_events_[i].notify();
         return;
       }
     }
   }
+  else if (!wake_status_[preferred].exchange(true))
+  {
+    local_work_[preferred] = std::move(work);
+    wake_events_[preferred].notify();
+    return;
+  }
+
+  {
+    auto& queue = wg.work_queues_[preferred - wg.start_thread_idx_];
+    auto  lck   = std::scoped_lock(queue.first);
+    queue.second.emplace_back(std::move(work));
+  }
+  // Let an idle worker near the preferred one steal it, if the preferred worker is busy for a while
+  wake_one(wg);
+}
+
+void scheduler::set_worker_topology(worker_id worker, worker_topology topology)
+{
+  if (worker.get_index() >= topology_.size())
+  {
+    topology_.resize(worker.get_index() + 1);
+  }
+  topology_[worker.get_index()] = topology;
+}
+
+void scheduler::build_steal_order(ouly::detail::workgroup& group) const
+{
+  auto count          = group.thread_count_;
+  group.steal_order_  = std::make_unique<uint32_t[]>(static_cast<size_t>(count) * count);
+  auto distance_class = [&](uint32_t own, uint32_t other) -> uint32_t
+  {
+    auto const& a = topology_[group.start_thread_idx_ + own];
+    auto const& b = topology_[group.start_thread_idx_ + other];
+    if (own == other)
+    {
+      return 0U;
+    }
+    if (a.core_id_ != std::numeric_limits<uint32_t>::max() && a.core_id_ == b.core_id_)
+    {
+      return 1U;
+    }
+    return a.cache_id_ == b.cache_id_ ? 2U : 3U;
+  };
+
+  for (uint32_t own = 0; own < count; ++own)
+  {
+    auto* row = group.steal_order_.get() + (static_cast<size_t>(own) * count);
+    std::iota(row, row + count, 0U);
+    // Within a class, keep the round robin order starting after the own queue, so thieves spread out
+    std::stable_sort(row, row + count,
+                     [&](uint32_t first, uint32_t second)
+                     {
+                       auto fc = distance_class(own, first);
+                       auto sc = distance_class(own, second);
+                       if (fc != sc)
+                       {
+                         return fc < sc;
+                       }
+                       return ((first + count - own) % count) < ((second + count - own) % count);
+                     });
+  }
 }
 
 void scheduler::create_group(workgroup_id group, uint32_t thread_offset, uint32_t thread_count, uint32_t priority)
@@ -363,8 +729,9 @@ void scheduler::clear_group(workgroup_id group)
 {
   workgroups_[group.get_index()].start_thread_idx_ = 0;
   workgroups_[group.get_index()].thread_count_     = 0;
-  workgroups_[group.get_index()].push_offset_      = 0;
   workgroups_[group.get_index()].work_queues_      = nullptr;
+  workgroups_[group.get_index()].injection_        = nullptr;
+  workgroups_[group.get_index()].steal_order_      = nullptr;
 }
 
 } // namespace ouly
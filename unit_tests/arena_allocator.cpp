@@ -1,11 +1,19 @@
 #include "ouly/allocators/arena_allocator.hpp"
 #include "catch2/catch_all.hpp"
+#include "ouly/allocators/detail/simd_search.hpp"
+#include "ouly/allocators/parallel_move_executor.hpp"
 #include "ouly/allocators/strat/best_fit_tree.hpp"
 #include "ouly/allocators/strat/best_fit_v0.hpp"
 #include "ouly/allocators/strat/best_fit_v1.hpp"
 #include "ouly/allocators/strat/best_fit_v2.hpp"
 #include "ouly/allocators/strat/greedy_v0.hpp"
 #include "ouly/allocators/strat/greedy_v1.hpp"
+#include "ouly/allocators/strat/slotted_v0.hpp"
+#include "ouly/allocators/strat/slotted_v1.hpp"
+#include "ouly/allocators/strat/tlsf.hpp"
+#include "ouly/allocators/vm_arena_manager.hpp"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <random>
 #include <unordered_set>
@@ -45,6 +53,18 @@ struct alloc_mem_manager
       arenas_[l.arena_][s + l.offset_] = static_cast<char>(generator(gen));
   }
 
+  bool is_intact(allocation const& l) const
+  {
+    std::minstd_rand                   gen;
+    std::uniform_int_distribution<int> generator(65, 122);
+    for (std::size_t s = 0; s < l.size_; ++s)
+    {
+      if (arenas_[l.arena_][s + l.offset_] != static_cast<char>(generator(gen)))
+        return false;
+    }
+    return true;
+  }
+
   std::uint32_t add_arena([[maybe_unused]] std::uint32_t id, [[maybe_unused]] std::size_t size_)
   {
     arena_data_t arena_;
@@ -159,6 +179,119 @@ void run_test(unsigned int seed)
   }
 }
 
+TEMPLATE_TEST_CASE("arena_allocator defragment_step", "[arena_allocator][defrag]", (ouly::strat::best_fit_v2<>),
+                   (ouly::strat::best_fit_tree<>), (ouly::strat::tlsf<>), (ouly::strat::slotted_v1<>))
+{
+  using allocator_t =
+   ouly::arena_allocator<ouly::config<ouly::cfg::strategy<TestType>, ouly::cfg::manager<alloc_mem_manager>,
+                                      ouly::cfg::basic_size_type<uint32_t>, ouly::cfg::compute_stats>>;
+
+  alloc_mem_manager                       mgr;
+  allocator_t                             allocator(1024, mgr);
+  std::minstd_rand                        gen(7);
+  std::uniform_int_distribution<uint32_t> generator(1, 10);
+
+  auto allocate_one = [&]()
+  {
+    auto huser                     = static_cast<std::uint32_t>(mgr.allocs_.size());
+    auto size_                     = generator(gen) * TestType::min_granularity;
+    auto [arena_, halloc, offset_] = allocator.allocate(size_, {}, huser);
+    mgr.allocs_.emplace_back(arena_, halloc, offset_, size_);
+    mgr.fill(mgr.allocs_.back());
+  };
+
+  for (int i = 0; i < 200; ++i)
+    allocate_one();
+  for (std::size_t h = 0; h < mgr.allocs_.size(); h += 2)
+  {
+    allocator.deallocate(mgr.allocs_[h].alloc_id_);
+    mgr.allocs_[h].size_ = 0;
+  }
+  REQUIRE(allocator.fragmented_size() > 0);
+
+  // The allocator stays usable between steps
+  std::uint32_t steps = 1;
+  while (!allocator.defragment_step(64))
+  {
+    allocate_one();
+    steps++;
+  }
+  CHECK(steps > 1);
+  CHECK(allocator.fragmented_size() == 0);
+  allocator.validate_integrity();
+
+  for (auto const& l : mgr.allocs_)
+    REQUIRE(mgr.is_intact(l));
+
+  // A budget smaller than any block still makes progress
+  for (std::size_t h = 1; h < mgr.allocs_.size(); h += 4)
+  {
+    allocator.deallocate(mgr.allocs_[h].alloc_id_);
+    mgr.allocs_[h].size_ = 0;
+  }
+  while (!allocator.defragment_step(1))
+    ;
+  CHECK(allocator.fragmented_size() == 0);
+  for (auto const& l : mgr.allocs_)
+    REQUIRE(mgr.is_intact(l));
+}
+
+TEST_CASE("arena_allocator defragment with parallel_move_executor", "[arena_allocator][defrag]")
+{
+  using allocator_t = ouly::arena_allocator<
+   ouly::config<ouly::cfg::manager<alloc_mem_manager>, ouly::cfg::basic_size_type<uint32_t>, ouly::cfg::compute_stats>>;
+
+  ouly::scheduler scheduler;
+  scheduler.create_group(ouly::workgroup_id(0), 0, 4);
+  scheduler.begin_execution();
+  auto const& ctx = ouly::worker_context::get(ouly::default_workgroup_id);
+
+  alloc_mem_manager mgr;
+  allocator_t       allocator(8 * 1024 * 1024, mgr);
+
+  auto allocate_one = [&](std::uint32_t size_)
+  {
+    auto huser                     = static_cast<std::uint32_t>(mgr.allocs_.size());
+    auto [arena_, halloc, offset_] = allocator.allocate(size_, {}, huser);
+    mgr.allocs_.emplace_back(arena_, halloc, offset_, size_);
+    mgr.fill(mgr.allocs_.back());
+  };
+  auto deallocate_every = [&](std::size_t first, std::size_t step)
+  {
+    for (std::size_t h = first; h < mgr.allocs_.size(); h += step)
+    {
+      if (mgr.allocs_[h].size_ == 0)
+        continue;
+      allocator.deallocate(mgr.allocs_[h].alloc_id_);
+      mgr.allocs_[h].size_ = 0;
+    }
+  };
+
+  // Coalesced moves are larger than move_chunk_size, and moves land on memory freed by earlier ones
+  for (std::uint32_t i = 0; i < 48; ++i)
+    allocate_one(((i % 5) + 1) * 64 * 1024);
+  deallocate_every(0, 3);
+
+  allocator.defragment(ouly::parallel_move_executor(ctx));
+  allocator.validate_integrity();
+  for (auto const& l : mgr.allocs_)
+    REQUIRE(mgr.is_intact(l));
+
+  for (std::uint32_t i = 0; i < 16; ++i)
+    allocate_one(((i % 3) + 1) * 48 * 1024);
+  deallocate_every(1, 4);
+  REQUIRE(allocator.fragmented_size() > 0);
+
+  while (!allocator.defragment_step(512 * 1024, ouly::parallel_move_executor(ctx)))
+    ;
+  CHECK(allocator.fragmented_size() == 0);
+  allocator.validate_integrity();
+  for (auto const& l : mgr.allocs_)
+    REQUIRE(mgr.is_intact(l));
+
+  scheduler.end_execution();
+}
+
 TEST_CASE("arena_allocator without memory manager", "[arena_allocator][default]")
 {
   ouly::arena_allocator<> allocator(1024);
@@ -180,6 +313,168 @@ TEST_CASE("arena_allocator without memory manager", "[arena_allocator][default]"
   REQUIRE(xoffset != 0);
 }
 
+TEST_CASE("arena_allocator telemetry", "[arena_allocator][stats]")
+{
+  ouly::arena_allocator<ouly::config<ouly::cfg::compute_histograms>> allocator(1024);
+
+  [[maybe_unused]] auto [aloc, aoffset] = allocator.allocate(1);
+  auto [bloc, boffset]                  = allocator.allocate(3);
+  [[maybe_unused]] auto [cloc, coffset] = allocator.allocate(100);
+  [[maybe_unused]] auto [dloc, doffset] = allocator.allocate(300);
+  allocator.deallocate(bloc);
+
+  auto t = allocator.telemetry();
+  CHECK(t.sizes_[1] == 1);
+  CHECK(t.sizes_[2] == 1);
+  CHECK(t.sizes_[7] == 1);
+  CHECK(t.sizes_[9] == 1);
+
+  std::uint64_t allocations = 0, deallocations = 0;
+  for (auto v : t.allocation_ticks_)
+    allocations += v;
+  for (auto v : t.deallocation_ticks_)
+    deallocations += v;
+  CHECK(allocations == 4);
+  CHECK(deallocations == 1);
+  CHECK(t.ticks_per_us_ > 0.0);
+  CHECK(t.allocation_latency_us(0.5) <= t.allocation_latency_us(0.99));
+
+  REQUIRE(t.arenas_.size() == 1);
+  CHECK(t.arenas_[0].size_ == 1024);
+  CHECK(t.arenas_[0].free_ == 1024 - 1 - 100 - 300);
+  CHECK(t.arenas_[0].free_blocks_ == 2);
+  CHECK(t.arenas_[0].largest_free_ == 1024 - 1 - 3 - 100 - 300);
+  CHECK(t.arenas_[0].fragmentation() > 0.0);
+  CHECK(t.fragmentation() == t.arenas_[0].fragmentation());
+
+  auto json = t.to_json();
+  CHECK(json.starts_with("{\"sizes\":[0,1,1,0,0,0,0,1,0,1,"));
+  CHECK(json.find("\"arenas\":[{\"id\":") != std::string::npos);
+  CHECK(json.ends_with("}]}"));
+
+  // Without compute_histograms only the arena walk is filled
+  ouly::arena_allocator<> plain(1024);
+  [[maybe_unused]] auto p = plain.allocate(64);
+  auto                  pt = plain.telemetry();
+  CHECK(pt.sizes_[7] == 0);
+  CHECK(pt.arenas_.size() == 1);
+  CHECK(pt.arenas_[0].free_blocks_ == 1);
+}
+
+TEST_CASE("arena_allocator with vm_arena_manager", "[arena_allocator][vm]")
+{
+  constexpr std::size_t k_arena_size = 64 * 1024;
+  ouly::vm_arena_manager mgr(4 * k_arena_size, 8);
+  REQUIRE(mgr.get_slot_size() >= 4 * k_arena_size);
+
+  using allocator_t = ouly::arena_allocator<ouly::config<ouly::cfg::manager<ouly::vm_arena_manager>>>;
+  allocator_t allocator(k_arena_size, mgr);
+
+  std::vector<std::tuple<std::uint32_t, std::uint32_t, std::size_t>> allocs;
+  for (std::uint32_t i = 0; i < 32; ++i)
+  {
+    auto [arena, id, offset] = allocator.allocate(8 * 1024);
+    REQUIRE(arena != ouly::vm_arena_manager::invalid_arena);
+    auto* data = static_cast<std::uint8_t*>(mgr.get_arena_data(arena)) + offset;
+    std::memset(data, static_cast<int>(i), 8 * 1024);
+    allocs.emplace_back(arena, id, offset);
+  }
+  REQUIRE(mgr.get_committed_size() >= 4 * k_arena_size);
+
+  for (std::uint32_t i = 0; i < 32; ++i)
+  {
+    auto [arena, id, offset] = allocs[i];
+    auto* data               = static_cast<std::uint8_t*>(mgr.get_arena_data(arena)) + offset;
+    REQUIRE(data[0] == i);
+    REQUIRE(data[8 * 1024 - 1] == i);
+  }
+
+  // Arenas stay in place while they grow
+  auto  first = std::get<0>(allocs[0]);
+  auto* base  = mgr.get_arena_data(first);
+  REQUIRE(mgr.grow_arena(first, 2 * k_arena_size));
+  REQUIRE(mgr.get_arena_data(first) == base);
+  REQUIRE(mgr.get_arena_size(first) >= 2 * k_arena_size);
+  REQUIRE(!mgr.grow_arena(first, mgr.get_slot_size() + 1));
+
+  // Empty arenas are dropped and their pages released
+  for (auto [arena, id, offset] : allocs)
+  {
+    allocator.deallocate(id);
+  }
+  REQUIRE(mgr.get_committed_size() == 0);
+
+  // Explicit huge pages fall back to regular pages when the system has none configured
+  ouly::vm_arena_manager huge(1, 2, ouly::cfg::vm_page_mode::e_huge_tlb);
+  REQUIRE(huge.get_slot_size() == 2 * 1024 * 1024);
+  auto slot = huge.add_arena(0, 4096);
+  REQUIRE(slot != ouly::vm_arena_manager::invalid_arena);
+  std::memset(huge.get_arena_data(slot), 1, 4096);
+  REQUIRE(huge.drop_arena(slot));
+}
+
+TEST_CASE("arena_allocator with vm_arena_manager out of slots", "[arena_allocator][vm]")
+{
+  constexpr std::size_t k_arena_size = 64 * 1024;
+  ouly::vm_arena_manager mgr(k_arena_size, 2);
+
+  using allocator_t = ouly::arena_allocator<ouly::config<ouly::cfg::manager<ouly::vm_arena_manager>>>;
+  allocator_t allocator(k_arena_size, mgr);
+
+  // Larger than a slot
+  auto [big_arena, big_id, big_offset] = allocator.allocate(static_cast<std::uint32_t>(mgr.get_slot_size() + 1));
+  REQUIRE(big_id == allocator_t::null());
+  allocator.validate_integrity();
+
+  std::vector<std::uint32_t> ids;
+  for (std::uint32_t i = 0; i < 16; ++i)
+  {
+    auto [arena, id, offset] = allocator.allocate(8 * 1024);
+    REQUIRE(id != allocator_t::null());
+    ids.push_back(id);
+  }
+
+  // Both slots are in use
+  auto [full_arena, full_id, full_offset] = allocator.allocate(8 * 1024);
+  REQUIRE(full_id == allocator_t::null());
+  allocator.validate_integrity();
+
+  for (auto id : ids)
+  {
+    allocator.deallocate(id);
+  }
+  REQUIRE(mgr.get_committed_size() == 0);
+
+  auto [arena, id, offset] = allocator.allocate(8 * 1024);
+  REQUIRE(id != allocator_t::null());
+  allocator.deallocate(id);
+}
+
+TEST_CASE("simd_lower_bound matches std::lower_bound", "[arena_allocator][simd]")
+{
+  std::minstd_rand                        gen(7);
+  std::uniform_int_distribution<uint32_t> value(0, 2000);
+  std::vector<uint32_t>                   sizes;
+  std::vector<uint64_t>                   wide;
+  for (uint32_t count = 0; count < 300; ++count)
+  {
+    for (uint32_t key = 0; key < 2002; key += 7)
+    {
+      auto expected = std::lower_bound(sizes.begin(), sizes.end(), key) - sizes.begin();
+      REQUIRE(ouly::detail::simd_lower_bound(sizes.data(), sizes.size(), key) - sizes.data() == expected);
+      auto wide_expected = std::lower_bound(wide.begin(), wide.end(), uint64_t{key}) - wide.begin();
+      REQUIRE(ouly::detail::simd_lower_bound(wide.data(), wide.size(), uint64_t{key}) - wide.data() == wide_expected);
+    }
+    auto v = value(gen);
+    sizes.insert(std::upper_bound(sizes.begin(), sizes.end(), v), v);
+    wide.insert(std::upper_bound(wide.begin(), wide.end(), uint64_t{v} << 33), uint64_t{v} << 33);
+  }
+  // Values with the top bit set must not compare as negative
+  std::vector<uint32_t> high = {1U, 0x7fffffffU, 0x80000000U, 0x80000001U, 0xfffffff0U, 0xffffffffU};
+  REQUIRE(ouly::detail::simd_lower_bound(high.data(), high.size(), 0x80000000U) - high.data() == 2);
+  REQUIRE(ouly::detail::simd_lower_bound(high.data(), high.size(), 0xfffffff1U) - high.data() == 5);
+}
+
 TEMPLATE_TEST_CASE("Validate arena_allocator", "[arena_allocator.strat]",
 
                    (ouly::strat::best_fit_v1<ouly::cfg::bsearch_min2>),
@@ -187,8 +482,14 @@ TEMPLATE_TEST_CASE("Validate arena_allocator", "[arena_allocator.strat]",
                    (ouly::strat::best_fit_v1<ouly::cfg::bsearch_min1>),
                    (ouly::strat::best_fit_v2<ouly::cfg::bsearch_min0>),
                    (ouly::strat::best_fit_v2<ouly::cfg::bsearch_min1>),
-                   (ouly::strat::best_fit_v2<ouly::cfg::bsearch_min2>), (ouly::strat::greedy_v1<>),
-                   (ouly::strat::greedy_v0<>), (ouly::strat::best_fit_tree<>), (ouly::strat::best_fit_v0<>)
+                   (ouly::strat::best_fit_v2<ouly::cfg::bsearch_min2>),
+                   (ouly::strat::best_fit_v2<ouly::cfg::bsearch_simd>), (ouly::strat::greedy_v1<>),
+                   (ouly::strat::greedy_v0<>), (ouly::strat::best_fit_tree<>), (ouly::strat::best_fit_v0<>),
+                   (ouly::strat::tlsf<>), (ouly::strat::slotted_v0<>), (ouly::strat::slotted_v1<>),
+                   (ouly::strat::slotted_v0<ouly::config<ouly::cfg::granularity<8>, ouly::cfg::max_bucket<4>,
+                                                         ouly::cfg::fallback_start<ouly::strat::best_fit_tree<>>>>),
+                   (ouly::strat::slotted_v1<ouly::config<ouly::cfg::granularity<4>, ouly::cfg::max_bucket<8>,
+                                                         ouly::cfg::fixed_max_per_slot<2>>>)
 
 )
 {
@@ -203,8 +504,14 @@ TEMPLATE_TEST_CASE("Validate arena_allocator : 1542249547 init bug", "[arena_all
                    (ouly::strat::best_fit_v1<ouly::cfg::bsearch_min1>),
                    (ouly::strat::best_fit_v2<ouly::cfg::bsearch_min0>),
                    (ouly::strat::best_fit_v2<ouly::cfg::bsearch_min1>),
-                   (ouly::strat::best_fit_v2<ouly::cfg::bsearch_min2>), (ouly::strat::greedy_v1<>),
-                   (ouly::strat::greedy_v0<>), (ouly::strat::best_fit_tree<>), (ouly::strat::best_fit_v0<>)
+                   (ouly::strat::best_fit_v2<ouly::cfg::bsearch_min2>),
+                   (ouly::strat::best_fit_v2<ouly::cfg::bsearch_simd>), (ouly::strat::greedy_v1<>),
+                   (ouly::strat::greedy_v0<>), (ouly::strat::best_fit_tree<>), (ouly::strat::best_fit_v0<>),
+                   (ouly::strat::tlsf<>), (ouly::strat::slotted_v0<>), (ouly::strat::slotted_v1<>),
+                   (ouly::strat::slotted_v0<ouly::config<ouly::cfg::granularity<8>, ouly::cfg::max_bucket<4>,
+                                                         ouly::cfg::fallback_start<ouly::strat::best_fit_tree<>>>>),
+                   (ouly::strat::slotted_v1<ouly::config<ouly::cfg::granularity<4>, ouly::cfg::max_bucket<8>,
+                                                         ouly::cfg::fixed_max_per_slot<2>>>)
 
 )
 {
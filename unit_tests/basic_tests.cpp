@@ -13,7 +13,12 @@
 #include "ouly/utility/wyhash.hpp"
 #include "ouly/utility/zip_view.hpp"
 #include "test_common.hpp"
+#include <algorithm>
+#include <atomic>
+#include <random>
 #include <span>
+#include <thread>
+#include <vector>
 
 // NOLINTBEGIN
 
@@ -113,6 +118,107 @@ TEST_CASE("Validate general_allocator", "[general_allocator]")
   allocator_t::deallocate(nullptr, 0, {});
 }
 
+TEST_CASE("Validate sampling memory tracker", "[general_allocator]")
+{
+  using namespace ouly;
+  // A one byte interval samples every allocation
+  using allocator_t = default_allocator<ouly::config<ouly::cfg::sample_memory<1>>>;
+  auto& tracker     = allocator_t::tracker::impl::get_instance();
+
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 10; ++i)
+    ptrs.push_back(allocator_t::allocate(64));
+  CHECK(tracker.sample_count() == 10);
+  CHECK(tracker.estimated_live_bytes() == Catch::Approx(640.0));
+
+  std::size_t sampled = 0;
+  tracker.for_each_sample(
+   [&](void* ptr, std::size_t size, auto const&)
+   {
+     CHECK(std::find(ptrs.begin(), ptrs.end(), ptr) != ptrs.end());
+     sampled += size;
+   });
+  CHECK(sampled == 640);
+
+  for (int i = 0; i < 5; ++i)
+    allocator_t::deallocate(ptrs[i], 64);
+  CHECK(tracker.sample_count() == 5);
+  for (int i = 5; i < 10; ++i)
+    allocator_t::deallocate(ptrs[i], 64);
+  CHECK(tracker.sample_count() == 0);
+  CHECK(tracker.dropped_samples() == 0);
+
+  // 64 KB allocated in small blocks with a 16 MB interval is expected to leave no sample
+  using sparse_allocator_t = default_allocator<ouly::config<ouly::cfg::sample_memory<16UL * 1024UL * 1024UL>>>;
+  auto& sparse             = sparse_allocator_t::tracker::impl::get_instance();
+  ptrs.clear();
+  for (int i = 0; i < 1024; ++i)
+    ptrs.push_back(sparse_allocator_t::allocate(64));
+  CHECK(sparse.sample_count() <= 2);
+  for (auto p : ptrs)
+    sparse_allocator_t::deallocate(p, 64);
+  CHECK(sparse.sample_count() == 0);
+}
+
+TEST_CASE("Validate sampling memory tracker with concurrent threads", "[general_allocator]")
+{
+  using namespace ouly;
+  using allocator_t = default_allocator<ouly::config<ouly::cfg::sample_memory<1>>>;
+  auto& tracker     = allocator_t::tracker::impl::get_instance();
+
+  constexpr std::uint32_t  nb_threads = 4;
+  constexpr std::uint32_t  nb_rounds  = 4000;
+  std::atomic_bool         done       = false;
+  std::vector<std::thread> threads;
+  for (std::uint32_t t = 0; t < nb_threads; ++t)
+  {
+    threads.emplace_back(
+     [t]()
+     {
+       std::minstd_rand                           gen(t + 1);
+       std::vector<std::pair<void*, std::size_t>> live;
+       for (std::uint32_t round = 0; round < nb_rounds; ++round)
+       {
+         if (live.size() < 32 && (live.empty() || gen() % 2 == 0))
+         {
+           std::size_t size = 16 + (gen() % 64);
+           live.emplace_back(allocator_t::allocate(size), size);
+         }
+         else
+         {
+           auto index = gen() % live.size();
+           allocator_t::deallocate(live[index].first, live[index].second);
+           live[index] = live.back();
+           live.pop_back();
+         }
+       }
+       for (auto [p, size] : live)
+         allocator_t::deallocate(p, size);
+     });
+  }
+  // Readers hold slots for a moment while frees and inserts race on them
+  std::thread reader(
+   [&]()
+   {
+     while (!done.load())
+       (void)tracker.estimated_live_bytes();
+   });
+
+  for (auto& t : threads)
+    t.join();
+  done = true;
+  reader.join();
+
+  CHECK(tracker.sample_count() == 0);
+  std::uint32_t remaining = 0;
+  tracker.for_each_sample(
+   [&](void*, std::size_t, auto const&)
+   {
+     remaining++;
+   });
+  CHECK(remaining == 0);
+}
+
 TEST_CASE("Validate tagged_ptr", "[tagged_ptr]")
 {
   using namespace ouly;
@@ -1,13 +1,22 @@
 #define ANKERL_NANOBENCH_IMPLEMENT
 #include "nanobench.h"
 #include "ouly/allocators/arena_allocator.hpp"
+#include "ouly/allocators/concurrent_pool_allocator.hpp"
+#include "ouly/allocators/pool_allocator.hpp"
 #include "ouly/allocators/strat/best_fit_tree.hpp"
 #include "ouly/allocators/strat/best_fit_v0.hpp"
 #include "ouly/allocators/strat/best_fit_v1.hpp"
 #include "ouly/allocators/strat/best_fit_v2.hpp"
 #include "ouly/allocators/strat/greedy_v0.hpp"
 #include "ouly/allocators/strat/greedy_v1.hpp"
+#include "ouly/allocators/strat/slotted_v0.hpp"
+#include "ouly/allocators/strat/slotted_v1.hpp"
+#include "ouly/allocators/strat/tlsf.hpp"
+#include <barrier>
+#include <mutex>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 // NOLINTBEGIN
 struct alloc_mem_manager
@@ -79,13 +88,113 @@ void bench_arena(uint32_t size, std::string_view name)
                           });
 }
 
+template <typename Allocator>
+void bench_pool_contention(Allocator& allocator, uint32_t nb_threads, std::string_view name)
+{
+  constexpr uint32_t nbatch = 100000;
+  constexpr uint32_t depth  = 64;
+
+  auto churn = [&allocator](rand_device& dev)
+  {
+    void* live[depth] = {};
+    for (uint32_t i = 0; i < nbatch; ++i)
+    {
+      auto& slot = live[dev.update() % depth];
+      if (slot != nullptr)
+      {
+        allocator.deallocate(slot, 32);
+        slot = nullptr;
+      }
+      else
+      {
+        slot = allocator.allocate(32);
+      }
+    }
+    for (auto* slot : live)
+    {
+      if (slot != nullptr)
+      {
+        allocator.deallocate(slot, 32);
+      }
+    }
+  };
+
+  // Threads are started once, every epoch only releases them through the barrier and waits for them to finish
+  std::barrier             start(nb_threads);
+  std::barrier             finish(nb_threads);
+  bool                     stop = false;
+  std::vector<std::thread> threads;
+  threads.reserve(nb_threads - 1);
+  for (uint32_t t = 1; t < nb_threads; ++t)
+  {
+    threads.emplace_back(
+     [&, t]()
+     {
+       rand_device dev{.seed = 2147483647 - t};
+       while (true)
+       {
+         start.arrive_and_wait();
+         if (stop)
+         {
+           break;
+         }
+         churn(dev);
+         finish.arrive_and_wait();
+       }
+     });
+  }
+
+  rand_device              dev{.seed = 2147483647};
+  ankerl::nanobench::Bench bench;
+  bench.output(&std::cout);
+  bench.minEpochIterations(5);
+  bench.batch(nbatch * nb_threads)
+   .run(std::string{name} + "-t" + std::to_string(nb_threads),
+        [&]
+        {
+          start.arrive_and_wait();
+          churn(dev);
+          finish.arrive_and_wait();
+        });
+
+  stop = true;
+  start.arrive_and_wait();
+  for (auto& t : threads)
+  {
+    t.join();
+  }
+}
+
+struct locked_pool_allocator
+{
+  auto allocate(std::size_t size) -> void*
+  {
+    auto lck = std::scoped_lock(lock);
+    return pool.allocate(size);
+  }
+
+  void deallocate(void* ptr, std::size_t size)
+  {
+    auto lck = std::scoped_lock(lock);
+    pool.deallocate(ptr, size);
+  }
+
+  std::mutex            lock;
+  ouly::pool_allocator<> pool{32, 1024};
+};
+
+void bench_pool_contention(uint32_t nb_threads)
+{
+  locked_pool_allocator locked;
+  bench_pool_contention(locked, nb_threads, "pool+mutex");
+  ouly::concurrent_pool_allocator<> concurrent(32, 1024);
+  bench_pool_contention(concurrent, nb_threads, "concurrent-pool");
+}
+
 int main(int argc, char* argv[])
 {
   constexpr uint32_t size = 256 * 256;
 
-  //  (ouly::strat::slotted_v0<uint32_t, 256, 255, 4, ouly::strat::best_fit_tree<uint32_t>>),
-  //  (ouly::strat::slotted_v1<uint32_t, 256, 255, 4, ouly::strat::best_fit_tree<uint32_t>>),
-  //  (ouly::strat::slotted_v2<uint32_t, 256, 255, 8, 4, ouly::strat::best_fit_tree<uint32_t>>)
   bench_arena<ouly::strat::greedy_v0<>>(size, "greedy-v0");
   bench_arena<ouly::strat::greedy_v0<>>(size, "greedy-v0");
   bench_arena<ouly::strat::greedy_v1<>>(size, "greedy-v1");
@@ -97,6 +206,17 @@ int main(int argc, char* argv[])
   bench_arena<ouly::strat::best_fit_v2<ouly::cfg::bsearch_min0>>(size, "bf-v2-min0");
   bench_arena<ouly::strat::best_fit_v2<ouly::cfg::bsearch_min1>>(size, "bf-v2-min1");
   bench_arena<ouly::strat::best_fit_v2<ouly::cfg::bsearch_min2>>(size, "bf-v2-min2");
+  bench_arena<ouly::strat::best_fit_v2<ouly::cfg::bsearch_simd>>(size, "bf-v2-simd");
+  bench_arena<ouly::strat::tlsf<>>(size, "tlsf");
+  bench_arena<ouly::strat::slotted_v0<>>(size, "slotted-v0");
+  bench_arena<ouly::strat::slotted_v1<>>(size, "slotted-v1");
+  bench_arena<ouly::strat::slotted_v0<ouly::config<ouly::cfg::fallback_start<ouly::strat::best_fit_tree<>>>>>(
+   size, "slotted-v0-bf-tree");
+
+  for (uint32_t nb_threads : {1U, 2U, 4U, 8U})
+  {
+    bench_pool_contention(nb_threads);
+  }
 
   return 0;
 }
@@ -1,8 +1,12 @@
 #include "ouly/allocators/coalescing_allocator.hpp"
 #include "catch2/catch_all.hpp"
 #include "ouly/allocators/coalescing_arena_allocator.hpp"
+#include "ouly/allocators/sharded_coalescing_arena_allocator.hpp"
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <random>
+#include <thread>
 #include <unordered_set>
 
 // NOLINTBEGIN
@@ -132,6 +136,303 @@ TEST_CASE("coalescing_arena_allocator dedictated arena_ tests", "[coalescing_are
   REQUIRE(mgr.arena_count_ == 1);
 }
 
+TEST_CASE("coalescing_arena_allocator batch allocate and deallocate", "[coalescing_arena_allocator][default]")
+{
+  constexpr uint32_t               page_size = 1000;
+  alloc_mem_manager                mgr;
+  ouly::coalescing_arena_allocator allocator;
+  allocator.set_arena_size(page_size);
+
+  // Leave holes of 100 and 300 in the first arena
+  auto a = allocator.allocate(100, mgr);
+  auto b = allocator.allocate(50, mgr);
+  auto c = allocator.allocate(300, mgr);
+  auto d = allocator.allocate(550, mgr);
+  allocator.deallocate(a.get_allocation_id(), mgr);
+  allocator.deallocate(c.get_allocation_id(), mgr);
+  REQUIRE(mgr.arena_count_ == 1);
+
+  // 90 and 280 fill the holes best fit, 400 and 500 share one new arena, 1200 gets its own
+  std::array<ouly::allocation_size_type, 5> sizes = {500, 280, 1200, 90, 400};
+  std::array<ouly::ca_allocation, 5>        out   = {};
+  allocator.allocate_many(std::span<ouly::allocation_size_type const>(sizes), mgr, std::span(out));
+  allocator.validate_integrity();
+
+  CHECK(out[3].get_arena_id() == a.get_arena_id());
+  CHECK(out[3].get_offset() == a.get_offset());
+  CHECK(out[1].get_arena_id() == c.get_arena_id());
+  CHECK(out[1].get_offset() == c.get_offset());
+  CHECK(out[0].get_arena_id() == out[4].get_arena_id());
+  CHECK(out[0].get_arena_id() != a.get_arena_id());
+  CHECK(out[2].get_offset() == 0);
+  CHECK(mgr.arena_count_ == 3);
+  for (std::size_t i = 0; i < sizes.size(); ++i)
+    CHECK(allocator.get_size(out[i].get_allocation_id()) == sizes[i]);
+
+  // Adjacent blocks of the batch are released together, emptied arenas are handed back to the manager
+  std::array<ouly::allocation_id, 5> ids = {out[4].get_allocation_id(), out[2].get_allocation_id(),
+                                            out[1].get_allocation_id(), out[0].get_allocation_id(),
+                                            b.get_allocation_id()};
+  allocator.deallocate_many(std::span<ouly::allocation_id const>(ids), mgr);
+  allocator.validate_integrity();
+  CHECK(mgr.arena_count_ == 1);
+
+  allocator.deallocate(d.get_allocation_id(), mgr);
+  allocator.deallocate(out[3].get_allocation_id(), mgr);
+  allocator.validate_integrity();
+  CHECK(mgr.arena_count_ == 0);
+
+  // Random batches against the single call path
+  uint32_t                                seed = 1847702527;
+  std::vector<ouly::allocation_id>        live;
+  std::vector<ouly::allocation_size_type> batch;
+  std::vector<ouly::ca_allocation>        result;
+  for (uint32_t round = 0; round < 200; ++round)
+  {
+    batch.resize(1 + xorshift(seed) % 32);
+    for (auto& s : batch)
+      s = 1 + xorshift(seed) % (page_size + page_size / 4);
+    result.assign(batch.size(), {});
+    allocator.allocate_many(std::span<ouly::allocation_size_type const>(batch), mgr, std::span(result));
+    for (std::size_t i = 0; i < batch.size(); ++i)
+    {
+      REQUIRE(allocator.get_size(result[i].get_allocation_id()) == batch[i]);
+      live.push_back(result[i].get_allocation_id());
+    }
+    allocator.validate_integrity();
+
+    std::vector<ouly::allocation_id> release;
+    for (std::size_t i = 0; i < live.size();)
+    {
+      if (xorshift(seed) & 1)
+      {
+        release.push_back(live[i]);
+        live[i] = live.back();
+        live.pop_back();
+      }
+      else
+        ++i;
+    }
+    allocator.deallocate_many(std::span<ouly::allocation_id const>(release), mgr);
+    allocator.validate_integrity();
+  }
+  allocator.deallocate_many(std::span<ouly::allocation_id const>(live), mgr);
+  allocator.validate_integrity();
+  CHECK(mgr.arena_count_ == 0);
+}
+
+TEST_CASE("sharded_coalescing_arena_allocator", "[coalescing_arena_allocator][default]")
+{
+  struct locked_mem_manager
+  {
+    std::mutex        lock_;
+    alloc_mem_manager mgr_;
+
+    void add(ouly::arena_id id, uint32_t size)
+    {
+      auto lock = std::scoped_lock(lock_);
+      mgr_.add(id, size);
+    }
+
+    void remove(ouly::arena_id id)
+    {
+      auto lock = std::scoped_lock(lock_);
+      mgr_.remove(id);
+    }
+  };
+
+  constexpr uint32_t                       page_size = 10000;
+  locked_mem_manager                       mgr;
+  ouly::sharded_coalescing_arena_allocator allocator(4, page_size);
+  REQUIRE(allocator.get_shard_count() == 4);
+  REQUIRE(allocator.get_arena_size() == page_size);
+
+  // Another thread steals from the arena of this one instead of adding its own
+  auto first = allocator.allocate(100, mgr);
+  REQUIRE(allocator.get_shard(first.get_arena_id()) == allocator.get_local_shard());
+  REQUIRE(allocator.get_shard(first.get_allocation_id()) == allocator.get_local_shard());
+  ouly::ca_allocation second;
+  std::thread([&] { second = allocator.allocate(200, mgr); }).join();
+  CHECK(second.get_arena_id() == first.get_arena_id());
+  CHECK(second.get_offset() == 100);
+  CHECK(allocator.get_size(second.get_allocation_id()) == 200);
+  CHECK(allocator.get_arena(second.get_allocation_id()) == first.get_arena_id());
+  CHECK(mgr.mgr_.arena_count_ == 1);
+  allocator.deallocate(first, mgr);
+  allocator.deallocate(second.get_allocation_id(), mgr);
+  CHECK(mgr.mgr_.arena_count_ == 0);
+
+  constexpr uint32_t       thread_count = 4;
+  std::vector<std::thread> threads;
+  std::vector<std::vector<ouly::ca_allocation>> live(thread_count);
+  for (uint32_t t = 0; t < thread_count; ++t)
+  {
+    threads.emplace_back(
+     [&, t]
+     {
+       uint32_t seed = 1847702527 + t;
+       for (uint32_t i = 0; i < 5000; ++i)
+       {
+         if ((xorshift(seed) & 0x3) || live[t].empty())
+         {
+           auto size = 1 + xorshift(seed) % (page_size / 4);
+           live[t].push_back(allocator.allocate(size, mgr));
+         }
+         else
+         {
+           auto chosen = xorshift(seed) % live[t].size();
+           allocator.deallocate(live[t][chosen], mgr);
+           live[t][chosen] = live[t].back();
+           live[t].pop_back();
+         }
+       }
+     });
+  }
+  for (auto& t : threads)
+    t.join();
+  allocator.validate_integrity();
+
+  // No two live allocations overlap
+  std::vector<std::tuple<uint16_t, uint64_t, uint64_t>> ranges;
+  for (auto const& l : live)
+    for (auto const& a : l)
+      ranges.emplace_back(a.get_arena_id().get(), a.get_offset(),
+                          a.get_offset() + allocator.get_size(a.get_allocation_id()));
+  std::ranges::sort(ranges);
+  for (std::size_t i = 1; i < ranges.size(); ++i)
+    if (std::get<0>(ranges[i]) == std::get<0>(ranges[i - 1]))
+      REQUIRE(std::get<2>(ranges[i - 1]) <= std::get<1>(ranges[i]));
+
+  for (auto const& l : live)
+    for (auto const& a : l)
+      allocator.deallocate(a, mgr);
+  allocator.validate_integrity();
+  CHECK(mgr.mgr_.arena_count_ == 0);
+
+  // With 16384 shards a shard can own at most 3 arenas before its ids run out of the arena_id range
+  ouly::sharded_coalescing_arena_allocator crowded(16384, page_size);
+  std::vector<ouly::ca_allocation>         dedicated;
+  std::unordered_set<uint16_t>             arena_ids;
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    auto al = crowded.allocate(page_size, mgr);
+    if (al.get_allocation_id() == ouly::allocation_id())
+      break;
+    REQUIRE(al.get_arena_id() != ouly::arena_id());
+    REQUIRE(arena_ids.insert(al.get_arena_id().get()).second);
+    dedicated.push_back(al);
+  }
+  CHECK(dedicated.size() >= 2);
+  CHECK(dedicated.size() <= 3);
+  CHECK(mgr.mgr_.arena_count_ == dedicated.size());
+  crowded.deallocate(dedicated.back(), mgr);
+  dedicated.back() = crowded.allocate(page_size, mgr);
+  CHECK(dedicated.back().get_allocation_id() != ouly::allocation_id());
+  for (auto const& a : dedicated)
+    crowded.deallocate(a, mgr);
+  CHECK(mgr.mgr_.arena_count_ == 0);
+}
+
+TEST_CASE("coalescing_allocator best fit", "[coalescing_allocator][default]")
+{
+  ouly::coalescing_allocator allocator;
+  // Leave holes of 64, 32 and 128 between live blocks
+  auto                  a = allocator.allocate(64);
+  auto                  b = allocator.allocate(16);
+  auto                  c = allocator.allocate(32);
+  auto                  d = allocator.allocate(16);
+  auto                  e = allocator.allocate(128);
+  [[maybe_unused]] auto f = allocator.allocate(16);
+  allocator.deallocate(a, 64);
+  allocator.deallocate(c, 32);
+  allocator.deallocate(e, 128);
+  REQUIRE(allocator.get_free_block_count() == 4);
+  REQUIRE(allocator.allocate(30) == c);
+  REQUIRE(allocator.allocate(60) == a);
+  REQUIRE(allocator.allocate(100) == e);
+  // Both merge with the tails left above, [60, 80) and [110, 128), the smaller one wins
+  allocator.deallocate(b, 16);
+  allocator.deallocate(d, 16);
+  REQUIRE(allocator.allocate(16) == c + 30);
+}
+
+TEST_CASE("coalescing_allocator random", "[coalescing_allocator][default]")
+{
+  ouly::coalescing_allocator allocator;
+  std::minstd_rand           gen(7);
+  using size_type = ouly::coalescing_allocator::size_type;
+  std::map<size_type, size_type> live;
+  for (std::uint32_t i = 0; i < 20000; ++i)
+  {
+    if (live.empty() || (gen() % 5) < 3)
+    {
+      auto size   = static_cast<size_type>(1 + (gen() % 1000));
+      auto offset = allocator.allocate(size);
+      // No overlap with the neighbours
+      auto next   = live.lower_bound(offset);
+      REQUIRE((next == live.end() || offset + size <= next->first));
+      REQUIRE((next == live.begin() || std::prev(next)->first + std::prev(next)->second <= offset));
+      live.emplace(offset, size);
+    }
+    else
+    {
+      auto it = live.begin();
+      std::advance(it, gen() % live.size());
+      allocator.deallocate(it->first, it->second);
+      live.erase(it);
+    }
+  }
+  for (auto [offset, size] : live)
+  {
+    allocator.deallocate(offset, size);
+  }
+  REQUIRE(allocator.get_free_block_count() == 1);
+  REQUIRE(allocator.allocate(1 << 20) == 0);
+}
+
+TEST_CASE("coalescing_allocator used up runs", "[coalescing_allocator][default]")
+{
+  using size_type = ouly::coalescing_allocator::size_type;
+  constexpr size_type        block_size = 16;
+  constexpr uint32_t         count      = 2048;
+  ouly::coalescing_allocator allocator;
+  std::vector<size_type>     blocks(count);
+  for (auto& b : blocks)
+  {
+    b = allocator.allocate(block_size);
+  }
+  // Every other block becomes a hole that is then used up again, leaving long runs of empty entries
+  for (uint32_t round = 0; round < 3; ++round)
+  {
+    for (uint32_t i = round % 2; i < count; i += 2)
+    {
+      allocator.deallocate(blocks[i], block_size);
+    }
+    // The last odd block merges with the tail
+    REQUIRE(allocator.get_free_block_count() == count / 2 + (round % 2 == 0 ? 1 : 0));
+    for (uint32_t i = round % 2; i < count; i += 2)
+    {
+      blocks[i] = allocator.allocate(block_size);
+    }
+    REQUIRE(allocator.get_free_block_count() == 1);
+  }
+  // Scattered holes land next to the used up entries
+  for (uint32_t i = 0; i < count; i += 7)
+  {
+    allocator.deallocate(blocks[i], block_size);
+  }
+  REQUIRE(allocator.get_free_block_count() == (count + 6) / 7 + 1);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    if (i % 7 != 0)
+    {
+      allocator.deallocate(blocks[i], block_size);
+    }
+  }
+  REQUIRE(allocator.get_free_block_count() == 1);
+  REQUIRE(allocator.allocate(count * block_size) == 0);
+}
+
 TEST_CASE("coalescing_allocator without memory manager", "[coalescing_allocator][default]")
 {
   ouly::coalescing_allocator allocator;
@@ -1,7 +1,10 @@
 #include "ouly/allocators/linear_allocator.hpp"
 #include "catch2/catch_all.hpp"
+#include "ouly/allocators/frame_ring_allocator.hpp"
 #include "ouly/allocators/linear_arena_allocator.hpp"
 #include "ouly/allocators/linear_stack_allocator.hpp"
+#include "ouly/allocators/vm_arena_manager.hpp"
+#include <cstring>
 
 // NOLINTBEGIN
 TEST_CASE("Validate linear_allocator", "[linear_allocator]")
@@ -135,4 +138,130 @@ TEST_CASE("Validate linear_stack_allocator with alignment", "[linear_stack_alloc
   auto a1 = ouly::allocate<std::uint8_t>(allocator, 32, 0);
   CHECK(a1 == first);
 }
+
+TEST_CASE("Validate linear_arena_allocator with vm_allocator", "[linear_arena_allocator]")
+{
+  using allocator_t =
+   ouly::linear_arena_allocator<ouly::config<ouly::cfg::underlying_allocator<ouly::vm_allocator<>>>>;
+  allocator_t allocator(1024 * 1024);
+
+  auto* first = ouly::allocate<std::uint8_t>(allocator, 4096);
+  REQUIRE((reinterpret_cast<std::uintptr_t>(first) & 4095) == 0);
+  std::memset(first, 0xab, 4096);
+  auto* second = ouly::allocate<std::uint8_t>(allocator, 100);
+  CHECK(first + 4096 == second);
+  auto* large = ouly::allocate<std::uint8_t>(allocator, 2 * 1024 * 1024);
+  std::memset(large, 0xcd, 2 * 1024 * 1024);
+  CHECK(2 == allocator.get_arena_count());
+  CHECK(first[4095] == 0xab);
+
+  using huge_allocator_t = ouly::linear_stack_allocator<ouly::config<ouly::cfg::underlying_allocator<
+   ouly::vm_allocator<ouly::config<ouly::cfg::page_mode<ouly::cfg::vm_page_mode::e_transparent_huge>>>>>>;
+  huge_allocator_t huge(4 * 1024 * 1024);
+  auto*            block = ouly::allocate<std::uint8_t>(huge, 1024);
+  std::memset(block, 1, 1024);
+  CHECK(block[1023] == 1);
+}
+
+TEST_CASE("Validate frame_ring_allocator", "[frame_ring_allocator]")
+{
+  using allocator_t = ouly::frame_ring_allocator<2>;
+  constexpr std::uint32_t k_chunk_size = 1024;
+  allocator_t             allocator(2, k_chunk_size);
+
+  auto const w0 = ouly::worker_id(0);
+  auto const w1 = ouly::worker_id(1);
+
+  CHECK(allocator.begin_frame() == 0);
+  auto* a = static_cast<std::uint8_t*>(allocator.allocate(w0, 100));
+  auto* b = static_cast<std::uint8_t*>(allocator.allocate(w0, 28));
+  CHECK(a + 100 == b);
+  auto* c = static_cast<std::uint8_t*>(allocator.allocate(w0, 16, ouly::alignment<64>()));
+  CHECK((reinterpret_cast<std::uintptr_t>(c) & 63) == 0);
+  // Workers bump their own chunks
+  auto* d = static_cast<std::uint8_t*>(allocator.allocate(w1, 100));
+  CHECK((d < a || d >= a + k_chunk_size));
+  // Overflow moves on to a new chunk, large requests get their own
+  auto* e = static_cast<std::uint8_t*>(allocator.allocate(w0, 1000));
+  CHECK((e < a || e >= a + k_chunk_size));
+  auto* large = static_cast<std::uint8_t*>(allocator.allocate(w0, 4096));
+  std::memset(large, 0xab, 4096);
+  CHECK(allocator.get_reserved_size() == 3 * k_chunk_size + 4096);
+
+  CHECK(allocator.begin_frame() == 1);
+  auto* f = static_cast<std::uint8_t*>(allocator.allocate(w0, 100));
+  CHECK((f < a || f >= a + k_chunk_size));
+
+  // Region 0 is still in use by frame 0
+  CHECK(!allocator.try_begin_frame());
+  allocator.retire(0);
+  CHECK(allocator.retired_count() == 1);
+  CHECK(allocator.try_begin_frame());
+  CHECK(allocator.current_frame() == 2);
+
+  // The region was reset as a whole, its chunks are reused
+  CHECK(allocator.allocate(w0, 100) == a);
+  CHECK(allocator.allocate(w0, 1000) == e);
+  CHECK(allocator.allocate(w1, 100) == d);
+  CHECK(allocator.get_reserved_size() == 3 * k_chunk_size + 4096 + k_chunk_size);
+
+  // Retiring a frame retires the ones before it
+  allocator.retire(2);
+  CHECK(allocator.retired_count() == 3);
+  CHECK(allocator.begin_frame() == 3);
+  CHECK(allocator.begin_frame() == 4);
+}
+
+struct budget_allocator
+{
+  using size_type = std::size_t;
+  using address   = void*;
+
+  static inline std::size_t budget = 0;
+
+  template <typename Alignment = ouly::alignment<>>
+  [[nodiscard]] static auto allocate(size_type size, [[maybe_unused]] Alignment align = {}) -> address
+  {
+    if (size > budget)
+    {
+      return null();
+    }
+    budget -= size;
+    return ::operator new(size);
+  }
+
+  template <typename Alignment = ouly::alignment<>>
+  static void deallocate(address addr, size_type size, [[maybe_unused]] Alignment align = {})
+  {
+    budget += size;
+    ::operator delete(addr);
+  }
+
+  static constexpr auto null() -> void*
+  {
+    return nullptr;
+  }
+};
+
+TEST_CASE("Validate frame_ring_allocator chunk failure", "[frame_ring_allocator]")
+{
+  using allocator_t = ouly::frame_ring_allocator<2, ouly::config<ouly::cfg::underlying_allocator<budget_allocator>>>;
+  constexpr std::uint32_t k_chunk_size = 1024;
+  budget_allocator::budget             = k_chunk_size;
+  {
+    allocator_t allocator(1, k_chunk_size);
+    auto const  w0 = ouly::worker_id(0);
+    allocator.begin_frame();
+    auto* a = allocator.allocate(w0, 1000);
+    CHECK(a != nullptr);
+    // The chunk could not be allocated, nothing is recorded for it
+    CHECK(allocator.allocate(w0, 100) == allocator_t::null());
+    CHECK(allocator.get_reserved_size() == k_chunk_size);
+    // Memory is available again, the allocator recovers
+    budget_allocator::budget = k_chunk_size;
+    CHECK(allocator.allocate(w0, 100) != nullptr);
+    CHECK(allocator.get_reserved_size() == 2 * k_chunk_size);
+  }
+  CHECK(budget_allocator::budget == 2 * k_chunk_size);
+}
 // NOLINTEND
\ No newline at end of file
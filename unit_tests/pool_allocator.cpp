@@ -1,7 +1,22 @@
 #include "ouly/allocators/pool_allocator.hpp"
 #include "catch2/catch_all.hpp"
+#include "ouly/allocators/concurrent_pool_allocator.hpp"
+#include "ouly/allocators/linear_arena_allocator.hpp"
+#include "ouly/allocators/linear_stack_allocator.hpp"
+#include "ouly/allocators/pmr_resource.hpp"
+#include "ouly/allocators/small_object_allocator.hpp"
 #include "ouly/allocators/std_allocator_wrapper.hpp"
+#include "ouly/allocators/thread_cached_pool_allocator.hpp"
+#include "ouly/containers/small_vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory_resource>
+#include <mutex>
 #include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 // NOLINTBEGIN
 TEST_CASE("Validate pool_allocator", "[pool_allocator]")
@@ -120,4 +135,320 @@ TEST_CASE("Validate std_allocator", "[std_allocator]")
       vlist.push_back(i);
   }
 }
+
+TEST_CASE("Validate pmr_resource", "[std_allocator]")
+{
+  auto fill = [](std::pmr::memory_resource& resource)
+  {
+    std::pmr::vector<std::uint32_t> values(&resource);
+    std::pmr::string                text("a string long enough to not fit the small buffer", &resource);
+    for (std::uint32_t i = 0; i < 100; ++i)
+      values.push_back(i);
+    auto* wide = resource.allocate(256, 64);
+    CHECK((reinterpret_cast<std::uintptr_t>(wide) & 63) == 0);
+    resource.deallocate(wide, 256, 64);
+    auto* odd  = resource.allocate(3, 1);
+    auto* next = resource.allocate(8, 8);
+    CHECK((reinterpret_cast<std::uintptr_t>(next) & 7) == 0);
+    resource.deallocate(next, 8, 8);
+    resource.deallocate(odd, 3, 1);
+    return values.size() == 100 && values.back() == 99 && text.size() > 40;
+  };
+
+  ouly::linear_arena_allocator<>                      arena;
+  ouly::pmr_resource<ouly::linear_arena_allocator<>&> arena_resource(arena);
+  CHECK(fill(arena_resource));
+  CHECK(arena.get_arena_count() == 1);
+
+  ouly::pmr_resource<ouly::linear_stack_allocator<>> stack_resource;
+  {
+    auto rewind = stack_resource.get_allocator().get_auto_rewind_point();
+    CHECK(fill(stack_resource));
+  }
+
+  ouly::pmr_resource<ouly::pool_allocator<>> pool_resource(16, 1000);
+  CHECK(fill(pool_resource));
+
+  ouly::pmr_resource<ouly::default_allocator<>> default_resource;
+  ouly::pmr_resource<ouly::default_allocator<>> other_default_resource;
+  CHECK(fill(default_resource));
+  CHECK(default_resource == other_default_resource);
+  CHECK(arena_resource != stack_resource);
+  CHECK_THROWS_AS(default_resource.allocate(64, 8192), std::bad_alloc);
+
+  // Arenas drawn from an upstream memory_resource
+  struct upstream_tag
+  {};
+  using upstream = ouly::pmr_upstream_allocator<upstream_tag>;
+  std::array<std::byte, 8192>         buffer{};
+  std::pmr::monotonic_buffer_resource monotonic(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+  upstream::set_resource(&monotonic);
+  {
+    ouly::linear_arena_allocator<ouly::config<ouly::cfg::underlying_allocator<upstream>>> upstream_arena(4096);
+    auto* data = static_cast<std::byte*>(upstream_arena.allocate(100));
+    CHECK(data >= buffer.data());
+    CHECK(data < buffer.data() + buffer.size());
+  }
+  upstream::set_resource(nullptr);
+  CHECK(upstream::get_resource() == std::pmr::get_default_resource());
+}
+
+TEST_CASE("Validate thread_cached_pool_allocator", "[pool_allocator]")
+{
+  using namespace ouly;
+  using allocator_t =
+   thread_cached_pool_allocator<ouly::config<ouly::cfg::compute_atomic_stats, ouly::cfg::magazine_size<16>>>;
+  struct trivial_object
+  {
+    std::uint64_t value[4];
+  };
+
+  allocator_t allocator(sizeof(trivial_object), 256);
+
+  constexpr std::uint32_t  nb_threads = 8;
+  constexpr std::uint32_t  nb_rounds  = 200;
+  std::atomic_uint32_t     corrupted  = 0;
+  std::vector<std::thread> threads;
+  for (std::uint32_t t = 0; t < nb_threads; ++t)
+  {
+    threads.emplace_back(
+     [&, t]()
+     {
+       std::minstd_rand             gen(t);
+       std::vector<trivial_object*> live;
+       for (std::uint32_t round = 0; round < nb_rounds; ++round)
+       {
+         auto count = gen() % 64;
+         for (std::uint32_t i = 0; i < count; ++i)
+         {
+           auto* obj = static_cast<trivial_object*>(allocator.allocate(sizeof(trivial_object)));
+           std::fill(std::begin(obj->value), std::end(obj->value), (std::uint64_t(t) << 32) | round);
+           live.push_back(obj);
+         }
+         // Multi atom requests go through the depot
+         auto* block = allocator.allocate(sizeof(trivial_object) * 3);
+         allocator.deallocate(block, sizeof(trivial_object) * 3);
+
+         while (live.size() > 16)
+         {
+           auto* obj = live.back();
+           live.pop_back();
+           auto expected = obj->value[0];
+           if (std::any_of(std::begin(obj->value), std::end(obj->value),
+                           [&](std::uint64_t v)
+                           {
+                             return v != expected || (v >> 32) != t;
+                           }))
+             corrupted++;
+           allocator.deallocate(obj, sizeof(trivial_object));
+         }
+       }
+       for (auto* obj : live)
+         allocator.deallocate(obj, sizeof(trivial_object));
+       CHECK(allocator.get_thread_cache_count() <= allocator_t::magazine_size);
+       allocator.flush_thread_cache();
+       CHECK(allocator.get_thread_cache_count() == 0);
+     });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(corrupted.load() == 0);
+
+  // Short lived allocators used by the same thread
+  for (std::uint32_t i = 0; i < 64; ++i)
+  {
+    allocator_t transient(sizeof(trivial_object), 16);
+    auto*       obj = transient.allocate(sizeof(trivial_object));
+    transient.deallocate(obj, sizeof(trivial_object));
+    CHECK(transient.get_thread_cache_count() == allocator_t::batch_size);
+  }
+  auto* obj = allocator.allocate(sizeof(trivial_object));
+  allocator.deallocate(obj, sizeof(trivial_object));
+  CHECK(allocator.get_thread_cache_count() == allocator_t::batch_size);
+
+  // A thread that exits returns its magazine and merges its counters without a flush
+  allocator_t exiting(sizeof(trivial_object), 16);
+  std::thread(
+   [&]()
+   {
+     std::vector<void*> atoms;
+     for (std::uint32_t i = 0; i < 10; ++i)
+       atoms.push_back(exiting.allocate(sizeof(trivial_object)));
+     for (auto* atom : atoms)
+       exiting.deallocate(atom, sizeof(trivial_object));
+     CHECK(exiting.get_thread_cache_count() != 0);
+   })
+   .join();
+  auto stats = exiting.print();
+  CHECK(stats.find("Total allocation call: 10\n") != std::string::npos);
+  CHECK(stats.find("Total deallocation call: 10\n") != std::string::npos);
+  CHECK(stats.find("Final allocation: 0\n") != std::string::npos);
+}
+
+TEST_CASE("Validate concurrent_pool_allocator", "[pool_allocator]")
+{
+  using namespace ouly;
+  using allocator_t = concurrent_pool_allocator<ouly::config<ouly::cfg::compute_atomic_stats>>;
+  struct trivial_object
+  {
+    std::uint64_t value[2];
+  };
+
+  allocator_t allocator(sizeof(trivial_object), 64);
+
+  // Producers allocate, consumers free, so most frees happen on another thread
+  constexpr std::uint32_t nb_pairs = 4;
+  constexpr std::uint32_t nb_items = 20000;
+  struct mailbox
+  {
+    std::mutex                                            lock;
+    std::vector<std::pair<trivial_object*, std::uint32_t>> items;
+    bool                                                  done = false;
+  };
+  std::vector<mailbox>     boxes(nb_pairs);
+  std::atomic_uint32_t     corrupted = 0;
+  std::atomic_uint32_t     freed     = 0;
+  std::vector<std::thread> threads;
+  for (std::uint32_t p = 0; p < nb_pairs; ++p)
+  {
+    threads.emplace_back(
+     [&, p]()
+     {
+       std::minstd_rand gen(p);
+       for (std::uint32_t i = 0; i < nb_items; ++i)
+       {
+         auto  count = 1 + (gen() % 4);
+         auto* obj   = static_cast<trivial_object*>(allocator.allocate(count * sizeof(trivial_object)));
+         for (std::uint32_t c = 0; c < count; ++c)
+           obj[c].value[0] = obj[c].value[1] = (std::uint64_t(p) << 32) | i;
+         auto lck = std::scoped_lock(boxes[p].lock);
+         boxes[p].items.emplace_back(obj, count);
+       }
+       auto lck      = std::scoped_lock(boxes[p].lock);
+       boxes[p].done = true;
+     });
+    threads.emplace_back(
+     [&, p]()
+     {
+       std::vector<std::pair<trivial_object*, std::uint32_t>> local;
+       bool                                                   done = false;
+       while (!done || !local.empty())
+       {
+         for (auto [obj, count] : local)
+         {
+           for (std::uint32_t c = 0; c < count; ++c)
+             if (obj[c].value[0] != obj[c].value[1] || (obj[c].value[0] >> 32) != p)
+               corrupted++;
+           allocator.deallocate(obj, count * sizeof(trivial_object));
+           freed++;
+         }
+         local.clear();
+         auto lck = std::scoped_lock(boxes[p].lock);
+         std::swap(local, boxes[p].items);
+         done = boxes[p].done;
+       }
+     });
+  }
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(corrupted.load() == 0);
+  REQUIRE(freed.load() == nb_pairs * nb_items);
+
+  // Freed blocks are reused, no new chunk is needed for the same sizes
+  auto chunks = allocator.get_chunk_count();
+  for (std::uint32_t i = 0; i < 1000; ++i)
+  {
+    auto* obj = allocator.allocate(sizeof(trivial_object));
+    allocator.deallocate(obj, sizeof(trivial_object));
+  }
+  REQUIRE(allocator.get_chunk_count() == chunks);
+
+  // Aligned and large requests
+  auto* aligned = allocator.allocate(24, ouly::alignment<64>());
+  REQUIRE((reinterpret_cast<std::uintptr_t>(aligned) & 63) == 0);
+  allocator.deallocate(aligned, 24, ouly::alignment<64>());
+  auto* large = allocator.allocate(sizeof(trivial_object) * 100);
+  allocator.deallocate(large, sizeof(trivial_object) * 100);
+
+  // Every call is counted, including the ones forwarded to the underlying allocator
+  auto calls = std::to_string(nb_pairs * nb_items + 1000 + 2);
+  auto stats = allocator.print();
+  CHECK(stats.find("Total allocation call: " + calls + "\n") != std::string::npos);
+  CHECK(stats.find("Total deallocation call: " + calls + "\n") != std::string::npos);
+  CHECK(stats.find("Final allocation: 0\n") != std::string::npos);
+}
+
+TEST_CASE("Validate small_object_allocator", "[pool_allocator]")
+{
+  using namespace ouly;
+  using allocator_t = small_object_allocator<ouly::config<ouly::cfg::compute_stats>>;
+
+  // Classes are contiguous, increasing, and no more than 12.5% apart after the linear range
+  for (std::size_t i = 0; i < allocator_t::class_count; ++i)
+  {
+    auto size = allocator_t::class_size(i);
+    REQUIRE(allocator_t::size_class(size) == i);
+    if (i > 0)
+    {
+      REQUIRE(allocator_t::size_class(allocator_t::class_size(i - 1) + 1) == i);
+    }
+    if (i > 8)
+    {
+      REQUIRE((size - allocator_t::class_size(i - 1)) * 8 <= allocator_t::class_size(i - 1));
+    }
+  }
+  REQUIRE(allocator_t::class_size(allocator_t::class_count - 1) == allocator_t::max_size);
+  REQUIRE(allocator_t::size_class(allocator_t::max_size + 1) == allocator_t::class_count);
+  REQUIRE(allocator_t::size_class(16, 64) == allocator_t::class_count);
+
+  allocator_t                                        allocator;
+  std::minstd_rand                                   gen(11);
+  std::vector<std::pair<std::uint8_t*, std::size_t>> live;
+  for (std::uint32_t i = 0; i < 10000; ++i)
+  {
+    if (live.empty() || (gen() % 3) != 0)
+    {
+      auto  size = 1 + (gen() % 1500);
+      auto* ptr  = static_cast<std::uint8_t*>(allocator.allocate(size));
+      REQUIRE((reinterpret_cast<std::uintptr_t>(ptr) % alignof(std::max_align_t)) == 0);
+      std::memset(ptr, static_cast<int>(size & 0xff), size);
+      live.emplace_back(ptr, size);
+    }
+    else
+    {
+      auto idx         = gen() % live.size();
+      auto [ptr, size] = live[idx];
+      REQUIRE(std::all_of(ptr, ptr + size,
+                          [size](std::uint8_t b)
+                          {
+                            return b == static_cast<std::uint8_t>(size & 0xff);
+                          }));
+      allocator.deallocate(ptr, size);
+      live[idx] = live.back();
+      live.pop_back();
+    }
+  }
+  for (auto [ptr, size] : live)
+    allocator.deallocate(ptr, size);
+
+  auto* aligned = allocator.allocate(40, ouly::alignment<64>());
+  REQUIRE((reinterpret_cast<std::uintptr_t>(aligned) & 63) == 0);
+  allocator.deallocate(aligned, 40, ouly::alignment<64>());
+
+  using shared_t = shared_small_object_allocator<>;
+  ouly::vector<std::uint32_t, shared_t>                                                 values;
+  ouly::small_vector<std::string, 2, ouly::config<ouly::cfg::allocator_type<shared_t>>> names;
+  for (std::uint32_t i = 0; i < 100; ++i)
+  {
+    values.push_back(i);
+    names.emplace_back(std::to_string(i));
+  }
+  for (std::uint32_t i = 0; i < 100; ++i)
+  {
+    REQUIRE(values[i] == i);
+    REQUIRE(names[i] == std::to_string(i));
+  }
+}
 // NOLINTEND
\ No newline at end of file
@@ -1,9 +1,14 @@
 #include "catch2/catch_all.hpp"
 #include "ouly/scheduler/parallel_for.hpp"
+#include "ouly/containers/small_vector.hpp"
+#include "ouly/scheduler/per_worker.hpp"
 #include "ouly/scheduler/scheduler.hpp"
+#include "ouly/scheduler/spawn.hpp"
+#include <algorithm>
 #include <numeric>
 #include <ranges>
 #include <string>
+#include <thread>
 
 // NOLINTBEGIN
 TEST_CASE("scheduler: Construction")
@@ -291,4 +296,594 @@ TEST_CASE("scheduler: Test submit_to")
     REQUIRE(collection[i] == i);
   }
 }
+
+TEST_CASE("scheduler: Blocked range tile orders")
+{
+  for (auto order : {ouly::tile_order::row_major, ouly::tile_order::morton, ouly::tile_order::hilbert})
+  {
+    auto range = ouly::blocked_range2d<uint32_t>({ouly::integer_range(3U, 103U), ouly::integer_range(0U, 37U)}, {8, 4},
+                                                 order);
+    REQUIRE(range.get_tile_count(0) == 13);
+    REQUIRE(range.get_tile_count(1) == 10);
+    REQUIRE(range.get_sequence_size() >= range.get_tile_count());
+
+    std::vector<uint32_t>                        hits(100 * 37, 0);
+    std::vector<std::pair<uint32_t, uint32_t>> visited;
+    range.for_each_tile(0, range.get_sequence_size(),
+                        [&](auto const& tile)
+                        {
+                          visited.emplace_back(tile[0].begin(), tile[1].begin());
+                          for (auto y = tile[1].begin(); y < tile[1].end(); ++y)
+                            for (auto x = tile[0].begin(); x < tile[0].end(); ++x)
+                              hits[y * 100 + (x - 3)]++;
+                        });
+    REQUIRE(visited.size() == range.get_tile_count());
+    REQUIRE(std::ranges::all_of(hits, [](uint32_t h) { return h == 1; }));
+
+    if (order == ouly::tile_order::hilbert)
+    {
+      // Without holes, the hilbert sequence only moves to adjacent tiles
+      auto square = ouly::blocked_range2d<uint32_t>({ouly::integer_range(0U, 64U), ouly::integer_range(0U, 32U)},
+                                                    {4, 4}, order);
+      REQUIRE(square.get_sequence_size() == square.get_tile_count());
+      ouly::blocked_range2d<uint32_t>::tile_type prev, next;
+      REQUIRE(square.get_tile(0, prev));
+      for (uint32_t i = 1; i < square.get_sequence_size(); ++i)
+      {
+        REQUIRE(square.get_tile(i, next));
+        auto dx = std::abs(static_cast<int>(next[0].begin()) - static_cast<int>(prev[0].begin()));
+        auto dy = std::abs(static_cast<int>(next[1].begin()) - static_cast<int>(prev[1].begin()));
+        REQUIRE(dx + dy == 4);
+        prev = next;
+      }
+    }
+  }
+
+  // Padded curve grids that need more than 32 bit sequence indices fall back to row major order
+  for (auto order : {ouly::tile_order::morton, ouly::tile_order::hilbert})
+  {
+    auto large = ouly::blocked_range2d<uint32_t>({ouly::integer_range(0U, 131073U), ouly::integer_range(0U, 16385U)},
+                                                 {1, 1}, order);
+    REQUIRE(large.get_order() == ouly::tile_order::row_major);
+    REQUIRE(large.get_sequence_size() == large.get_tile_count());
+  }
+}
+
+TEST_CASE("scheduler: Blocked range ParallelFor")
+{
+  ouly::scheduler scheduler;
+  scheduler.create_group(ouly::workgroup_id(0), 0, 8);
+  scheduler.begin_execution();
+
+  constexpr uint32_t width  = 67;
+  constexpr uint32_t height = 45;
+  constexpr uint32_t depth  = 13;
+
+  for (auto order : {ouly::tile_order::row_major, ouly::tile_order::morton, ouly::tile_order::hilbert})
+  {
+    std::vector<std::atomic_uint32_t> image(width * height);
+    ouly::parallel_for(
+     [&](ouly::integer_range<uint32_t> x, ouly::integer_range<uint32_t> y, ouly::worker_context const&)
+     {
+       for (auto j = y.begin(); j < y.end(); ++j)
+         for (auto i = x.begin(); i < x.end(); ++i)
+           image[j * width + i]++;
+     },
+     ouly::blocked_range2d<uint32_t>({ouly::integer_range(0U, width), ouly::integer_range(0U, height)}, {8, 8}, order),
+     ouly::default_workgroup_id);
+    REQUIRE(std::ranges::all_of(image, [](auto const& v) { return v.load() == 1; }));
+
+    std::vector<std::atomic_uint32_t> volume(width * height * depth);
+    ouly::parallel_for(
+     [&](ouly::integer_range<uint32_t> x, ouly::integer_range<uint32_t> y, ouly::integer_range<uint32_t> z,
+         ouly::worker_context const&)
+     {
+       for (auto k = z.begin(); k < z.end(); ++k)
+         for (auto j = y.begin(); j < y.end(); ++j)
+           for (auto i = x.begin(); i < x.end(); ++i)
+             volume[(k * height + j) * width + i]++;
+     },
+     ouly::blocked_range3d<uint32_t>(
+      {ouly::integer_range(0U, width), ouly::integer_range(0U, height), ouly::integer_range(0U, depth)}, {8, 4, 4},
+      order),
+     ouly::default_workgroup_id);
+    REQUIRE(std::ranges::all_of(volume, [](auto const& v) { return v.load() == 1; }));
+  }
+
+  scheduler.end_execution();
+}
+
+struct adaptive_sum_tag;
+struct adaptive_range_tag;
+
+TEST_CASE("scheduler: Adaptive ParallelFor")
+{
+  ouly::scheduler scheduler;
+  scheduler.create_group(ouly::workgroup_id(0), 0, 8);
+  scheduler.begin_execution();
+
+  using element_traits = ouly::adaptive_task_traits<adaptive_sum_tag>;
+  using range_traits   = ouly::adaptive_task_traits<adaptive_range_tag, 20>;
+
+  constexpr uint32_t nb_elements = 50000;
+  std::vector<int>   list(nb_elements);
+  std::iota(list.begin(), list.end(), 0);
+  int64_t const sum = std::accumulate(list.begin(), list.end(), int64_t{0});
+
+  for (uint32_t iteration = 0; iteration < 8; ++iteration)
+  {
+    std::atomic_int64_t parallel_sum = 0;
+    ouly::parallel_for(
+     [&parallel_sum](int a, ouly::worker_context const&)
+     {
+       parallel_sum += a;
+     },
+     std::span(list.begin(), list.end()), ouly::default_workgroup_id, element_traits{});
+    REQUIRE(parallel_sum.load() == sum);
+
+    parallel_sum = 0;
+    ouly::parallel_for(
+     [&parallel_sum](auto start, auto end, ouly::worker_context const&)
+     {
+       int64_t local = 0;
+       for (auto it = start; it != end; ++it)
+         local += *it;
+       parallel_sum += local;
+     },
+     std::span(list.begin(), list.end()), ouly::default_workgroup_id, range_traits{});
+    REQUIRE(parallel_sum.load() == sum);
+  }
+
+  REQUIRE(element_traits::tuner.get_sample_count() > 0);
+  REQUIRE(range_traits::tuner.get_sample_count() > 0);
+  REQUIRE(element_traits::tuner.get_cost_per_element_us() > 0.0);
+
+  scheduler.end_execution();
+}
+
+TEST_CASE("scheduler: Grain tuner batch sizes")
+{
+  ouly::grain_tuner tuner(30);
+  // First run splits evenly
+  REQUIRE(tuner.get_batch_size(1024, 8) == 32);
+  REQUIRE(tuner.get_batch_size(1024, 1) == 1024);
+
+  auto ticks_per_element = ouly::tsc_clock::from_us(1.0);
+  tuner.record(100, 100 * ticks_per_element);
+  // 1us per element with 30us target gives batches of ~30 elements
+  auto batch = tuner.get_batch_size(10000, 8);
+  REQUIRE(batch >= 25);
+  REQUIRE(batch <= 35);
+  // Less work than two batches runs serially
+  REQUIRE(tuner.get_batch_size(50, 8) == 50);
+
+  tuner.reset();
+  REQUIRE(tuner.get_sample_count() == 0);
+}
+
+TEST_CASE("scheduler: Per worker storage")
+{
+  ouly::scheduler scheduler;
+  scheduler.create_group(ouly::workgroup_id(0), 0, 8);
+  scheduler.begin_execution();
+
+  constexpr uint32_t    nb_elements = 10000;
+  std::vector<uint32_t> list(nb_elements);
+  std::iota(list.begin(), list.end(), 0);
+
+  ouly::per_worker<std::array<uint32_t, 16>> histogram(scheduler);
+  ouly::per_worker<std::vector<uint32_t>>    output(scheduler);
+  REQUIRE(histogram.size() == scheduler.get_worker_count());
+
+  ouly::parallel_for(
+   [&](uint32_t value, ouly::worker_context const& ctx)
+   {
+     histogram.local(ctx, std::array<uint32_t, 16>{})[value % 16]++;
+     output.local(ctx).push_back(value);
+   },
+   std::span(list.begin(), list.end()), ouly::default_workgroup_id);
+
+  auto total = histogram.combine(
+   [](auto a, auto const& b)
+   {
+     for (size_t i = 0; i < a.size(); ++i)
+       a[i] += b[i];
+     return a;
+   });
+  for (auto bucket : total)
+    REQUIRE(bucket == nb_elements / 16);
+
+  std::vector<uint32_t> merged;
+  output.for_each(
+   [&](std::vector<uint32_t> const& part)
+   {
+     REQUIRE(reinterpret_cast<std::uintptr_t>(&part) % ouly::detail::cache_line_size == 0);
+     merged.insert(merged.end(), part.begin(), part.end());
+   });
+  std::ranges::sort(merged);
+  REQUIRE(merged == list);
+
+  auto count = output.combine(size_t{0},
+                              [](size_t c, auto const& v)
+                              {
+                                return c + v.size();
+                              });
+  REQUIRE(count == nb_elements);
+
+  ouly::per_worker<std::vector<uint32_t>> moved(std::move(output));
+  REQUIRE(output.size() == 0);
+  REQUIRE(moved.size() == scheduler.get_worker_count());
+  REQUIRE(moved.combine(size_t{0},
+                        [](size_t c, auto const& v)
+                        {
+                          return c + v.size();
+                        }) == nb_elements);
+  output = std::move(moved);
+  REQUIRE(moved.size() == 0);
+  REQUIRE(output.size() == scheduler.get_worker_count());
+
+  output.clear();
+  REQUIRE(output.get(ouly::main_worker_id) == nullptr);
+  REQUIRE(output.combine(
+           [](auto a, auto const&)
+           {
+             return a;
+           })
+           .empty());
+
+  scheduler.end_execution();
+}
+
+TEST_CASE("scheduler: Worker scratch")
+{
+  ouly::scheduler scheduler;
+  scheduler.create_group(ouly::workgroup_id(0), 0, 4);
+  scheduler.begin_execution();
+
+  auto const& main_ctx = ouly::worker_context::get(ouly::default_workgroup_id);
+  REQUIRE(ouly::scratch_allocator().get_arena() == &main_ctx.get_scratch_arena());
+  {
+    auto  scope = main_ctx.scratch();
+    auto* data  = ouly::allocate<uint32_t>(ouly::scratch_allocator(main_ctx), sizeof(uint32_t) * 4);
+    data[3]     = 1;
+  }
+
+  constexpr uint32_t    nb_elements = 1000;
+  std::vector<uint32_t> list(nb_elements);
+  std::iota(list.begin(), list.end(), 0);
+
+  std::atomic_uint64_t sum        = 0;
+  std::atomic_uint32_t mismatches = 0;
+  ouly::parallel_for(
+   [&](uint32_t value, ouly::worker_context const& ctx)
+   {
+     auto& arena = ctx.get_scratch_arena();
+     void* first = nullptr;
+     {
+       auto scope = ctx.scratch();
+       first      = arena.allocate(16);
+
+       ouly::vector<uint32_t, ouly::scratch_allocator> values;
+       for (uint32_t i = 0; i <= value % 32; ++i)
+         values.push_back(value);
+
+       ouly::small_vector<uint64_t, 2, ouly::config<ouly::cfg::allocator_type<ouly::scratch_allocator>>> wide;
+       for (auto v : values)
+         wide.push_back(v);
+       if (wide.get_allocator().get_arena() != &arena)
+         mismatches++;
+
+       uint64_t local = 0;
+       for (auto v : wide)
+         local += v;
+       sum += local;
+     }
+     // Everything allocated in the scope was released
+     auto scope = ctx.scratch();
+     if (arena.allocate(16) != first)
+       mismatches++;
+   },
+   std::span(list.begin(), list.end()), ouly::default_workgroup_id);
+
+  uint64_t expected = 0;
+  for (auto v : list)
+    expected += uint64_t{v} * ((v % 32) + 1);
+  REQUIRE(sum.load() == expected);
+  REQUIRE(mismatches.load() == 0);
+
+  scheduler.end_execution();
+}
+
+TEST_CASE("scheduler: External submissions")
+{
+  ouly::scheduler scheduler;
+  auto            wg_default = ouly::workgroup_id(0);
+  auto            wg_stream  = ouly::workgroup_id(1);
+  scheduler.create_group(wg_default, 0, 4);
+  scheduler.create_group(wg_stream, 4, 4);
+  scheduler.begin_execution();
+
+  struct counters
+  {
+    std::atomic_uint32_t executed    = 0;
+    std::atomic_uint32_t wrong_group = 0;
+  };
+
+  constexpr uint32_t       nb_producers = 4;
+  constexpr uint32_t       nb_items     = 5000;
+  counters                 state;
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < nb_producers; ++p)
+  {
+    producers.emplace_back(
+     [&]()
+     {
+       for (uint32_t i = 0; i < nb_items; ++i)
+       {
+         // Main worker does not belong to the stream group, items go through the injection queue
+         scheduler.submit(ouly::main_worker_id, wg_stream,
+                          [s = &state, wg_stream](ouly::worker_context const& ctx)
+                          {
+                            if (!ctx.belongs_to(wg_stream) || ctx.get_worker().get_index() < 4)
+                              s->wrong_group++;
+                            s->executed++;
+                          });
+       }
+     });
+  }
+  for (auto& t : producers)
+    t.join();
+
+  scheduler.end_execution();
+  REQUIRE(state.executed.load() == nb_producers * nb_items);
+  REQUIRE(state.wrong_group.load() == 0);
+}
+
+TEST_CASE("scheduler: Multiple schedulers")
+{
+  ouly::scheduler first;
+  ouly::scheduler second;
+  first.create_group(ouly::default_workgroup_id, 0, 4);
+  second.create_group(ouly::default_workgroup_id, 0, 2);
+
+  first.begin_execution();
+  second.begin_execution();
+
+  // The main thread is the main worker of both, the most recent one is current
+  REQUIRE(&ouly::worker_context::get(ouly::default_workgroup_id).get_scheduler() == &second);
+  REQUIRE(&ouly::worker_context::get(first, ouly::default_workgroup_id).get_scheduler() == &first);
+  REQUIRE(ouly::worker_id::get(first) == ouly::main_worker_id);
+  REQUIRE(ouly::worker_id::get(second) == ouly::main_worker_id);
+
+  struct counters
+  {
+    std::atomic_uint32_t executed    = 0;
+    std::atomic_uint32_t wrong_owner = 0;
+  };
+
+  constexpr uint32_t nb_items = 1000;
+  counters           state;
+  for (uint32_t i = 0; i < nb_items; ++i)
+  {
+    // Tasks of the first scheduler forward work to the second one
+    ouly::async(ouly::worker_context::get(first, ouly::default_workgroup_id), ouly::default_workgroup_id,
+                [s = &state, t = &second](ouly::worker_context const& ctx)
+                {
+                  if (ouly::worker_id::get(*t) != ouly::external_worker_id || !ouly::worker_id::get(ctx.get_scheduler()))
+                    s->wrong_owner++;
+                  ouly::async(*t, ouly::default_workgroup_id,
+                              [s, t](ouly::worker_context const& inner)
+                              {
+                                if (&inner.get_scheduler() != t)
+                                  s->wrong_owner++;
+                                s->executed++;
+                              });
+                });
+  }
+
+  first.end_execution();
+  second.end_execution();
+  REQUIRE(state.executed.load() == nb_items);
+  REQUIRE(state.wrong_owner.load() == 0);
+
+  // Ending a scheduler restores the previously bound one as current
+  ouly::scheduler other;
+  other.create_group(ouly::default_workgroup_id, 0, 2);
+  first.begin_execution();
+  other.begin_execution();
+  other.end_execution();
+  REQUIRE(&ouly::worker_context::get(ouly::default_workgroup_id).get_scheduler() == &first);
+  REQUIRE(ouly::worker_id::get(other) == ouly::external_worker_id);
+  first.end_execution();
+}
+
+ouly::co_task<uint32_t> delayed_value(uint32_t value)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  co_return value;
+}
+
+TEST_CASE("scheduler: Parking sync wait")
+{
+  ouly::scheduler scheduler;
+  scheduler.create_group(ouly::default_workgroup_id, 0, 4);
+  scheduler.begin_execution();
+
+  // Main thread is a worker, it helps and parks on its wake event
+  auto first = delayed_value(1);
+  scheduler.submit(ouly::main_worker_id, ouly::default_workgroup_id, first);
+  REQUIRE(first.sync_wait_result(scheduler) == 1);
+
+  // A thread outside the scheduler waits before the task is even submitted
+  auto        second = delayed_value(2);
+  uint32_t    result = 0;
+  std::thread waiter(
+   [&]()
+   {
+     result = second.sync_wait_result(scheduler);
+   });
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  ouly::async(scheduler, ouly::default_workgroup_id, second);
+  waiter.join();
+  REQUIRE(result == 2);
+
+  // Workers waiting inside tasks
+  struct state
+  {
+    std::atomic_uint32_t sum = 0;
+  };
+  state              st;
+  constexpr uint32_t nb_waiters = 8;
+  for (uint32_t i = 0; i < nb_waiters; ++i)
+  {
+    ouly::async(ouly::worker_context::get(ouly::default_workgroup_id), ouly::default_workgroup_id,
+                [s = &st, i](ouly::worker_context const& ctx)
+                {
+                  auto inner = delayed_value(i);
+                  ouly::async(ctx, ouly::default_workgroup_id, inner);
+                  s->sum += inner.sync_wait_result(ctx.get_worker(), ctx.get_scheduler());
+                });
+  }
+  scheduler.end_execution();
+  REQUIRE(st.sum.load() == (nb_waiters * (nb_waiters - 1)) / 2);
+}
+
+#if defined(__clang__) || defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+TEST_CASE("scheduler: Deprecated busywork event")
+{
+  ouly::scheduler scheduler;
+  scheduler.create_group(ouly::default_workgroup_id, 0, 4);
+  scheduler.begin_execution();
+
+  ouly::busywork_event done;
+  std::atomic_uint32_t value = 0;
+  ouly::async(ouly::worker_context::get(ouly::default_workgroup_id), ouly::default_workgroup_id,
+              [&](ouly::worker_context const&)
+              {
+                value = 7;
+                done.notify();
+              });
+  done.wait(ouly::main_worker_id, scheduler);
+  REQUIRE(value.load() == 7);
+
+  ouly::busywork_event already_set(true);
+  already_set.wait(ouly::main_worker_id, scheduler);
+
+  scheduler.end_execution();
+}
+#if defined(__clang__) || defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+TEST_CASE("scheduler: Affinity hints")
+{
+  ouly::scheduler scheduler;
+  scheduler.create_group(ouly::default_workgroup_id, 0, 8);
+  // Two SMT siblings per core, four workers per cache
+  for (uint32_t w = 0; w < 8; ++w)
+    scheduler.set_worker_topology(ouly::worker_id(w), {.core_id_ = w / 2, .cache_id_ = w / 4});
+  scheduler.begin_execution();
+
+  struct state
+  {
+    std::atomic_uint32_t executed = 0;
+    std::atomic_uint32_t last     = std::numeric_limits<uint32_t>::max();
+  };
+  state st;
+  auto  record = [s = &st](ouly::worker_context const& ctx)
+  {
+    s->last = ctx.get_worker().get_index();
+    s->executed++;
+  };
+  auto wait_for = [&](uint32_t count)
+  {
+    while (st.executed.load() < count)
+      std::this_thread::yield();
+  };
+
+  // Let the workers go to sleep, a sleeping preferred worker receives the item directly
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  scheduler.submit(ouly::main_worker_id, ouly::prefer_worker(ouly::worker_id(5)), ouly::default_workgroup_id, record);
+  wait_for(1);
+  REQUIRE(st.last.load() == 5);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  scheduler.submit(ouly::main_worker_id, ouly::prefer_shared_cache(ouly::worker_id(6)), ouly::default_workgroup_id,
+                   record);
+  wait_for(2);
+  REQUIRE(st.last.load() >= 4);
+
+  constexpr uint32_t nb_items = 2000;
+  for (uint32_t i = 0; i < nb_items; ++i)
+  {
+    ouly::async(ouly::worker_context::get(ouly::default_workgroup_id), ouly::prefer_worker(ouly::worker_id(i % 8)),
+                ouly::default_workgroup_id, record);
+  }
+  scheduler.end_execution();
+  REQUIRE(st.executed.load() == nb_items + 2);
+}
+
+ouly::co_task<uint64_t> spawn_fib(ouly::scheduler& s, uint32_t n)
+{
+  if (n < 2)
+    co_return n;
+  auto a = spawn_fib(s, n - 1);
+  auto b = spawn_fib(s, n - 2);
+  co_await ouly::spawn(s, ouly::default_workgroup_id, a);
+  co_await ouly::spawn(s, ouly::default_workgroup_id, b);
+  auto ra = co_await a;
+  auto rb = co_await b;
+  co_return ra + rb;
+}
+
+ouly::co_task<void> spawn_order(ouly::scheduler& s, std::vector<uint32_t>& out, uint32_t begin, uint32_t end)
+{
+  if (end - begin == 1)
+  {
+    out.push_back(begin);
+    co_return;
+  }
+  auto mid   = begin + ((end - begin) / 2);
+  auto left  = spawn_order(s, out, begin, mid);
+  auto right = spawn_order(s, out, mid, end);
+  co_await ouly::spawn(s, ouly::default_workgroup_id, left);
+  co_await ouly::spawn(s, ouly::default_workgroup_id, right);
+  co_await left;
+  co_await right;
+}
+
+TEST_CASE("scheduler: Spawn with continuation stealing")
+{
+  {
+    // Single worker, nothing can be stolen, the order is the serial one
+    ouly::scheduler scheduler;
+    scheduler.create_group(ouly::default_workgroup_id, 0, 1);
+    scheduler.begin_execution();
+
+    std::vector<uint32_t> order;
+    auto                  task = spawn_order(scheduler, order, 0, 1000);
+    scheduler.submit(ouly::main_worker_id, ouly::default_workgroup_id, task);
+    task.sync_wait_result(scheduler);
+    scheduler.end_execution();
+
+    std::vector<uint32_t> expected(1000);
+    std::iota(expected.begin(), expected.end(), 0U);
+    REQUIRE(order == expected);
+  }
+
+  {
+    ouly::scheduler scheduler;
+    scheduler.create_group(ouly::default_workgroup_id, 0, 8);
+    scheduler.begin_execution();
+
+    auto task = spawn_fib(scheduler, 22);
+    scheduler.submit(ouly::main_worker_id, ouly::default_workgroup_id, task);
+    REQUIRE(task.sync_wait_result(scheduler) == 17711);
+    scheduler.end_execution();
+  }
+}
+
 // NOLINTEND
\ No newline at end of file